@@ -0,0 +1,24 @@
+TEMPLATE = app
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+TARGET = benchmark
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+# Input
+HEADERS += ../cell.h \
+           ../corridors.h \
+           ../generator.h \
+           ../maze.h \
+           ../movement.h \
+           ../replay.h \
+           ../solver.h
+SOURCES += main.cpp \
+           ../cell.cpp \
+           ../corridors.cpp \
+           ../generator.cpp \
+           ../maze.cpp \
+           ../movement.cpp \
+           ../replay.cpp \
+           ../solver.cpp
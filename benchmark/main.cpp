@@ -0,0 +1,678 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "corridors.h"
+#include "generator.h"
+#include "maze.h"
+#include "replay.h"
+#include "solver.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QStringList>
+#include <QTime>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// ============================================================================
+
+// Count heap allocations by wrapping the C library allocator, which Qt
+// containers and operator new both end up calling; generator threads
+// allocate too, so the count is changed atomically
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+
+static long allocation_count = 0;
+
+void* malloc(size_t size)
+{
+	__sync_add_and_fetch(&allocation_count, 1);
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+	__sync_add_and_fetch(&allocation_count, 1);
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+	__sync_add_and_fetch(&allocation_count, 1);
+	return __libc_realloc(pointer, size);
+}
+}
+
+static long allocations()
+{
+	return __sync_add_and_fetch(&allocation_count, 0);
+}
+#else
+static long allocations()
+{
+	return -1;
+}
+#endif
+
+// ============================================================================
+
+// The peak memory of the process only ever rises, so Linux is asked to
+// restart it before each run, and it is measured from where the run started
+#if defined(Q_OS_LINUX)
+// Reads a field in kilobytes from the memory status of the process
+static long readMemoryStatus(const char* field)
+{
+	long kb = -1;
+	FILE* file = std::fopen("/proc/self/status", "r");
+	if (file) {
+		char line[256];
+		size_t length = std::strlen(field);
+		while (std::fgets(line, sizeof(line), file)) {
+			if (std::strncmp(line, field, length) == 0) {
+				kb = std::atol(line + length);
+				break;
+			}
+		}
+		std::fclose(file);
+	}
+	return kb;
+}
+
+// Returns the resident memory in kilobytes that a run starts from, after
+// handing memory freed by earlier runs back so that it is counted again
+static long startPeakMemory()
+{
+#if defined(__GLIBC__)
+	malloc_trim(0);
+#endif
+	FILE* file = std::fopen("/proc/self/clear_refs", "w");
+	if (!file) {
+		return -1;
+	}
+	bool reset = (std::fputs("5", file) >= 0);
+	reset &= (std::fclose(file) == 0);
+	return reset ? readMemoryStatus("VmRSS:") : -1;
+}
+
+// Returns the most resident memory in kilobytes that a run added to its start
+static long peakMemory(long start)
+{
+	long peak = readMemoryStatus("VmHWM:");
+	return (start == -1 || peak == -1) ? -1 : peak - start;
+}
+#else
+static long startPeakMemory()
+{
+	return -1;
+}
+
+static long peakMemory(long)
+{
+	return -1;
+}
+#endif
+
+namespace {
+// ============================================================================
+
+// Base of the reference copies of replaced generators, kept to check that
+// the replacements carve identical mazes
+class ReferenceMaze : public Maze
+{
+protected:
+	QPoint randomNeighbor(const QPoint& cell);
+
+	QVector<bool> m_visited;
+};
+
+// ============================================================================
+
+QPoint ReferenceMaze::randomNeighbor(const QPoint& cell)
+{
+	QPoint neighbors[4];
+	int found = 0;
+	int index = cell.y() * columns() + cell.x();
+	if (cell.x() > 0 && !m_visited.at(index - 1)) {
+		neighbors[found++] = QPoint(cell.x() - 1, cell.y());
+	}
+	if (cell.y() > 0 && !m_visited.at(index - columns())) {
+		neighbors[found++] = QPoint(cell.x(), cell.y() - 1);
+	}
+	if (cell.y() < rows() - 1 && !m_visited.at(index + columns())) {
+		neighbors[found++] = QPoint(cell.x(), cell.y() + 1);
+	}
+	if (cell.x() < columns() - 1 && !m_visited.at(index + 1)) {
+		neighbors[found++] = QPoint(cell.x() + 1, cell.y());
+	}
+
+	if (found) {
+		const QPoint& n = neighbors[rand() % found];
+		m_visited[n.y() * columns() + n.x()] = true;
+		return n;
+	} else {
+		return QPoint(-1, -1);
+	}
+}
+
+// ============================================================================
+
+// Recursive backtracker as it was before it was made iterative
+class RecursiveReferenceMaze : public ReferenceMaze
+{
+private:
+	virtual void generate();
+	void makePath(const QPoint& current);
+};
+
+// ============================================================================
+
+void RecursiveReferenceMaze::generate()
+{
+	m_visited = QVector<bool>(columns() * rows(), false);
+
+	QPoint start(0, rand() % rows());
+	m_visited[start.y() * columns()] = true;
+	makePath(start);
+
+	m_visited.clear();
+}
+
+// ============================================================================
+
+void RecursiveReferenceMaze::makePath(const QPoint& current)
+{
+	QPoint neighbor;
+	while ( (neighbor = randomNeighbor(current)).x() != -1 ) {
+		mergeCells(current, neighbor);
+		makePath(neighbor);
+	}
+}
+
+// ============================================================================
+
+// Stack algorithm as it was before it became a growing tree template, with
+// the next active cell chosen through a virtual call
+class StackReferenceMaze : public ReferenceMaze
+{
+private:
+	virtual void generate();
+	virtual int nextActive(int size);
+};
+
+// ============================================================================
+
+void StackReferenceMaze::generate()
+{
+	m_visited = QVector<bool>(columns() * rows(), false);
+	QVector<QPoint> active;
+
+	QPoint start(0, rand() % rows());
+	m_visited[start.y() * columns()] = true;
+	active.append(start);
+
+	QPoint cell, neighbor;
+	int pos;
+	while (!active.isEmpty()) {
+		pos = nextActive(active.size());
+		cell = active.at(pos);
+		neighbor = randomNeighbor(cell);
+		if (neighbor.x() != -1) {
+			mergeCells(cell, neighbor);
+			active.append(neighbor);
+		} else {
+			active.remove(pos);
+		}
+	}
+
+	m_visited.clear();
+}
+
+// ============================================================================
+
+int StackReferenceMaze::nextActive(int size)
+{
+	return size - 1;
+}
+
+// ============================================================================
+
+bool sameWalls(const Maze& maze1, const Maze& maze2)
+{
+	if (maze1.columns() != maze2.columns() || maze1.rows() != maze2.rows()) {
+		return false;
+	}
+	for (int r = 0; r < maze1.rows(); ++r) {
+		for (int c = 0; c < maze1.columns(); ++c) {
+			const Cell& cell1 = maze1.cell(c, r);
+			const Cell& cell2 = maze2.cell(c, r);
+			if (cell1.leftWall() != cell2.leftWall() ||
+				cell1.rightWall() != cell2.rightWall() ||
+				cell1.topWall() != cell2.topWall() ||
+				cell1.bottomWall() != cell2.bottomWall()) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// ============================================================================
+
+int timeGeneration(Maze& maze, int size, unsigned int seed)
+{
+	srand(seed);
+	QTime time;
+	time.start();
+	maze.generate(size, size);
+	return time.elapsed();
+}
+
+// ============================================================================
+
+void printResult(const char* test, const char* algorithm, int size, unsigned int seed, int msecs, long peak_kb = -1, long allocations = -1)
+{
+	std::printf("%s,%s,%d,%d,%u,%d,%ld,%ld\n", test, algorithm, size, size, seed, msecs, peak_kb, allocations);
+}
+
+// ============================================================================
+
+const unsigned int seeds[] = { 1, 2, 3 };
+const int seed_count = sizeof(seeds) / sizeof(unsigned int);
+
+// Names of the algorithms made by Maze::create(), in order
+const char* const algorithms[] = {
+	"hunt_and_kill",
+	"kruskal",
+	"prim",
+	"recursive_backtracker",
+	"stack",
+	"stack_2",
+	"stack_3",
+	"stack_4",
+	"stack_5",
+	"fast_kruskal",
+	"fast_prim",
+	"fast_hunt_and_kill"
+};
+const int algorithm_count = sizeof(algorithms) / sizeof(algorithms[0]);
+
+// ============================================================================
+
+// Compare the recursive and iterative backtrackers; sizes are kept small
+// enough for the recursive version to fit in a default thread stack
+bool benchmarkBacktracker()
+{
+	static const int sizes[] = { 50, 99, 150, 200 };
+
+	bool success = true;
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (int j = 0; j < seed_count; ++j) {
+			RecursiveReferenceMaze recursive;
+			RecursiveBacktrackerMaze iterative;
+			printResult("backtracker", "recursive", sizes[i], seeds[j], timeGeneration(recursive, sizes[i], seeds[j]));
+			printResult("backtracker", "iterative", sizes[i], seeds[j], timeGeneration(iterative, sizes[i], seeds[j]));
+			if (!sameWalls(recursive, iterative)) {
+				std::fprintf(stderr, "Backtrackers differ at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+		}
+	}
+	return success;
+}
+
+// ============================================================================
+
+// Compare Prim's algorithm with a list frontier against the flat frontier
+bool benchmarkPrim()
+{
+	static const int sizes[] = { 50, 99, 200, 400, 800 };
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (int j = 0; j < seed_count; ++j) {
+			PrimMaze list;
+			FastPrimMaze flat;
+			printResult("prim", "list", sizes[i], seeds[j], timeGeneration(list, sizes[i], seeds[j]));
+			printResult("prim", "flat", sizes[i], seeds[j], timeGeneration(flat, sizes[i], seeds[j]));
+		}
+	}
+	return true;
+}
+
+// ============================================================================
+
+// Compare the virtual Stack algorithm with the growing tree template
+bool benchmarkGrowingTree()
+{
+	static const int sizes[] = { 50, 99, 200, 400, 800 };
+
+	bool success = true;
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (int j = 0; j < seed_count; ++j) {
+			StackReferenceMaze virtual_stack;
+			GrowingTreeMaze<NewestCell> growing_tree;
+			printResult("growing_tree", "virtual", sizes[i], seeds[j], timeGeneration(virtual_stack, sizes[i], seeds[j]));
+			printResult("growing_tree", "template", sizes[i], seeds[j], timeGeneration(growing_tree, sizes[i], seeds[j]));
+			if (!sameWalls(virtual_stack, growing_tree)) {
+				std::fprintf(stderr, "Growing trees differ at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+		}
+	}
+	return success;
+}
+
+// ============================================================================
+
+// Time every algorithm that a game can use, with its memory use
+bool benchmarkAlgorithms()
+{
+	// Hunt and kill takes about a minute at 800x800
+	static const int sizes[] = { 50, 100, 200, 400 };
+
+	for (int a = 0; a < algorithm_count; ++a) {
+		for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+			for (int j = 0; j < seed_count; ++j) {
+				Maze* maze = Maze::create(a);
+				long memory = startPeakMemory();
+				long start = allocations();
+				int msecs = timeGeneration(*maze, sizes[i], seeds[j]);
+				long count = (start == -1) ? -1 : allocations() - start;
+				printResult("generate", algorithms[a], sizes[i], seeds[j], msecs, peakMemory(memory), count);
+				delete maze;
+			}
+		}
+	}
+	return true;
+}
+
+// ============================================================================
+
+// Time saving and loading games, and check that loading restores them
+bool benchmarkSaveLoad()
+{
+	static const int sizes[] = { 50, 100, 200, 400, 800 };
+
+	bool success = true;
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (int j = 0; j < seed_count; ++j) {
+			Maze* maze = Maze::create(4);
+			timeGeneration(*maze, sizes[i], seeds[j]);
+
+			// Mark a path through part of the maze, like a game in progress
+			for (int c = 0; c < sizes[i]; c += 2) {
+				maze->cellMutable(c, c).setPathMarker(90);
+			}
+
+			QTime time;
+			time.start();
+			long start = allocations();
+			QString path = Maze::nextSaveFile();
+			bool saved_ok = maze->save(path);
+			long count = (start == -1) ? -1 : allocations() - start;
+			printResult("save", algorithms[4], sizes[i], seeds[j], time.elapsed(), -1, count);
+			QString previous = QSettings().value("Current/SaveFile").toString();
+			QSettings().setValue("Current/SaveFile", path);
+			if (!previous.isEmpty() && previous != path) {
+				QFile::remove(previous);
+			}
+
+			Maze* loaded = Maze::create(4);
+			timeGeneration(*loaded, sizes[i], seeds[j]);
+			time.start();
+			start = allocations();
+			bool loaded_ok = saved_ok && loaded->load();
+			count = (start == -1) ? -1 : allocations() - start;
+			printResult("load", algorithms[4], sizes[i], seeds[j], time.elapsed(), -1, count);
+
+			for (int c = 0; c < sizes[i] && loaded_ok; c += 2) {
+				loaded_ok = loaded->cell(c, c).pathMarker() == 90;
+			}
+			if (!loaded_ok) {
+				std::fprintf(stderr, "Loading failed at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+
+			delete loaded;
+			delete maze;
+		}
+	}
+	QSettings settings;
+	QFile::remove(settings.value("Current/SaveFile").toString());
+	settings.remove("Current");
+	return success;
+}
+
+// ============================================================================
+
+// Time placing the player and targets after the maze is generated
+bool benchmarkTargets()
+{
+	static const int sizes[] = { 10, 50, 200, 800 };
+	static const int targets[] = { 3, 99, 1000, Generator::MaximumTargets };
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (unsigned int t = 0; t < sizeof(targets) / sizeof(int); ++t) {
+			int count = qMin(targets[t], sizes[i] * sizes[i] - 1);
+			char name[32];
+			std::sprintf(name, "%d_targets", count);
+			for (int j = 0; j < seed_count; ++j) {
+				Generator generator;
+				QTime time;
+				time.start();
+				generator.generate(seeds[j], 4, sizes[i], sizes[i], count);
+				generator.wait();
+				int msecs = time.elapsed();
+				Maze* maze = generator.takeMaze();
+				printResult("targets", name, sizes[i], seeds[j], msecs - maze->generationTime());
+				delete maze;
+			}
+		}
+	}
+	return true;
+}
+
+// ============================================================================
+
+// Time building the tree of paths, single paths, and the route through all
+// targets, and building the graph of corridors between junctions
+bool benchmarkSolver()
+{
+	static const int sizes[] = { 200, 1000 };
+	static const int targets = 1000;
+	bool success = true;
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (int j = 0; j < seed_count; ++j) {
+			Generator generator;
+			generator.generate(seeds[j], 4, sizes[i], sizes[i], targets);
+			generator.wait();
+			QPoint start = generator.startLocation();
+			QList<QPoint> points = generator.targets();
+			Maze* maze = generator.takeMaze();
+
+			QTime time;
+			time.start();
+			Solver solver;
+			solver.build(maze, start);
+			printResult("solver", "build", sizes[i], seeds[j], time.elapsed());
+
+			time.restart();
+			QList<QPoint> path = solver.path(points.first(), points.last());
+			printResult("solver", "path", sizes[i], seeds[j], time.elapsed());
+
+			time.restart();
+			int steps = 0;
+			QList<QPoint> route = solver.route(points.first(), points, &steps);
+			printResult("solver", "route", sizes[i], seeds[j], time.elapsed());
+
+			time.restart();
+			CorridorGraph corridors;
+			corridors.build(maze);
+			printResult("solver", "corridors", sizes[i], seeds[j], time.elapsed());
+
+			// Check that the path only passes open walls, and that walking the
+			// route takes the steps it was scored at
+			bool open = path.first() == points.first() && path.last() == points.last();
+			for (int k = 1; k < path.size() && open; ++k) {
+				const QPoint& cell = path.at(k - 1);
+				QPoint step = path.at(k) - cell;
+				const Cell& walls = maze->cell(cell.x(), cell.y());
+				open = (step == QPoint(1, 0) && !walls.rightWall())
+					|| (step == QPoint(-1, 0) && !walls.leftWall())
+					|| (step == QPoint(0, 1) && !walls.bottomWall())
+					|| (step == QPoint(0, -1) && !walls.topWall());
+			}
+			if (!open) {
+				std::fprintf(stderr, "Path crosses a wall at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+			int walked = 0;
+			QPoint cell = points.first();
+			foreach (const QPoint& target, route) {
+				walked += solver.path(cell, target).size() - 1;
+				cell = target;
+			}
+			if (route.size() != points.size() - 1 || walked != steps) {
+				std::fprintf(stderr, "Route differs at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+			solver.route(start, points, &steps);
+			if (steps != generator.optimalSteps()) {
+				std::fprintf(stderr, "Optimal steps differ at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+			if (corridors.corridors() != corridors.junctions() - 1) {
+				std::fprintf(stderr, "Corridors do not form a tree at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+
+			delete maze;
+		}
+	}
+	return success;
+}
+
+// ============================================================================
+
+// Time playing back a long game without showing it, including building the maze
+bool benchmarkReplay()
+{
+	static const int sizes[] = { 50, 200, 800 };
+	static const int inputs = 100000;
+	QString filename = QDir::tempPath() + "/cutemaze-benchmark.replay";
+	bool success = true;
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(int); ++i) {
+		for (int j = 0; j < seed_count; ++j) {
+			// Press a random direction before every move, as fast as the game allows
+			Replay replay;
+			replay.start(seeds[j], 4, sizes[i], sizes[i], 3);
+			srand(seeds[j]);
+			for (int k = 0; k < inputs; ++k) {
+				replay.record(k, k * 200, Replay::DirectionKey, 1 + rand() % 4);
+			}
+
+			QTime time;
+			time.start();
+			Replay::Result result = replay.play();
+			printResult("replay", algorithms[4], sizes[i], seeds[j], time.elapsed());
+
+			// Check that a saved replay plays back the same way
+			Replay loaded;
+			bool loaded_ok = replay.save(filename) && loaded.load(filename);
+			if (loaded_ok) {
+				Replay::Result again = loaded.play();
+				loaded_ok = again.moves == result.moves && again.steps == result.steps && again.player == result.player;
+			}
+			if (!loaded_ok) {
+				std::fprintf(stderr, "Replay differs at size %d with seed %u\n", sizes[i], seeds[j]);
+				success = false;
+			}
+		}
+	}
+	QFile::remove(filename);
+	return success;
+}
+
+// ============================================================================
+
+// Play back a recorded game as fast as possible and print how it ended
+bool playReplay(const QString& filename)
+{
+	Replay replay;
+	if (!replay.load(filename)) {
+		std::fprintf(stderr, "Unable to load replay %s\n", qPrintable(filename));
+		return false;
+	}
+
+	QTime time;
+	time.start();
+	Replay::Result result = replay.play();
+	int msecs = time.elapsed();
+
+	std::printf("moves,steps,recorded_steps,targets_left,column,row,milliseconds,recorded_milliseconds\n");
+	std::printf("%d,%d,%d,%d,%d,%d,%d,%d\n", result.moves, result.steps, replay.steps(), result.targets, result.player.x(), result.player.y(), msecs, replay.msecs());
+	if (!result.valid) {
+		std::fprintf(stderr, "Replay does not match the recorded game\n");
+	}
+	return result.valid;
+}
+
+// ============================================================================
+}
+
+int main(int argc, char** argv)
+{
+	// Keep saved games of the benchmark apart from those of the game
+	QCoreApplication app(argc, argv);
+	app.setApplicationName("CuteMaze Benchmark");
+	app.setOrganizationDomain("gottcode.org");
+	app.setOrganizationName("GottCode");
+
+	// Play back a replay instead when asked for
+	QStringList arguments = app.arguments();
+	int replay = arguments.indexOf("--replay") + 1;
+	if (replay > 0 && replay < arguments.size()) {
+		return playReplay(arguments.at(replay)) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	std::printf("test,algorithm,columns,rows,seed,milliseconds,peak_kb,allocations\n");
+
+	bool success = true;
+	success &= benchmarkBacktracker();
+	success &= benchmarkPrim();
+	success &= benchmarkGrowingTree();
+	success &= benchmarkAlgorithms();
+	success &= benchmarkSaveLoad();
+	success &= benchmarkTargets();
+	success &= benchmarkSolver();
+	success &= benchmarkReplay();
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
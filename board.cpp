@@ -19,38 +19,121 @@
 
 #include "board.h"
 
+#include "generator.h"
 #include "maze.h"
+#include "movement.h"
+#include "solver.h"
 #include "theme.h"
 #include "ATKCode.h" // ADDED BY LARS PETTER MOSTAD
 
 #include <QApplication>
+#include <QFile>
 #include <QKeyEvent>
 #include <QMouseEvent> // ADDED BY TERJE GUNDERSEN
 #include <QLabel>
 #include <QMainWindow>
 #include <QMessageBox>
+#include <QPaintEvent>
 #include <QPainter>
+#include <QPen>
 #include <QSettings>
 #include <QStatusBar>
-#include <QTimeLine>
 #include <QTimer>
+#include <QVector>
 
+#include <cstdlib>
 #include <ctime>
 
 // ============================================================================
 
+namespace
+{
+
+// Cells cached around the visible ones in the static layer
+const int layer_margin = 4;
+
+// Moves journaled before the maze is saved again
+const int journal_limit = 1000;
+
+// Frame clock intervals, in milliseconds
+const int frame_interval = 16;
+const int animation_duration = 100;
+const int move_interval = 200;
+const int status_interval = 1000;
+
+// Read the size of the current maze from the settings
+void currentSize(const QSettings& settings, int& columns, int& rows)
+{
+	columns = settings.value("Current/Columns", settings.value("Current/Size", 50)).toInt();
+	columns = columns >= Maze::MinimumSize ? columns : Maze::MinimumSize;
+	columns = columns <= Maze::MaximumSize ? columns : Maze::MaximumSize;
+	rows = settings.value("Current/Rows", columns).toInt();
+	rows = rows >= Maze::MinimumSize ? rows : Maze::MinimumSize;
+	rows = rows <= Maze::MaximumSize ? rows : Maze::MaximumSize;
+}
+
+// Returns the journal kept next to a save file, if there is one
+QString journalFile(const QString& save_file)
+{
+	return save_file.isEmpty() ? QString() : save_file + ".journal";
+}
+
+// Removes both save files of the current game and their journals
+void removeSaveFiles(const QSettings& settings)
+{
+	QStringList save_files = QStringList() << settings.value("Current/SaveFile").toString() << Maze::nextSaveFile();
+	foreach (const QString& save_file, save_files) {
+		if (!save_file.isEmpty()) {
+			QFile::remove(save_file);
+			QFile::remove(journalFile(save_file));
+		}
+	}
+}
+
+// Settings that are replaced together with the save file
+const char* const saved_keys[] = {
+	"Current/SaveFile",
+	"Current/Player",
+	"Current/Rotation",
+	"Current/Steps",
+	"Current/Time"
+};
+const int saved_key_count = sizeof(saved_keys) / sizeof(saved_keys[0]);
+
+}
+
+// ============================================================================
+
 Board::Board(QMainWindow* parent)
 :	QWidget(parent),
 	m_done(false),
 	m_paused(false),
+	m_generating(false),
+	m_loading(false),
 	m_total_targets(3),
 	m_maze(0),
+	m_optimal_steps(-1),
 	m_show_path(true),
 	m_show_time(true),
 	m_show_steps(true),
 	m_smooth_movement(true),
 	m_col_delta(0),
 	m_row_delta(0),
+	m_animation_time(-1),
+	m_animation_duration(animation_duration),
+	m_move_clock(false),
+	m_move_time(0),
+	m_status_clock(false),
+	m_status_time(0),
+	m_recording(false),
+	m_replaying(false),
+	m_replay_event(0),
+	m_moves(0),
+	m_show_overview(false),
+	m_show_route(false),
+	m_show_statistics(false),
+	m_input_time(-1),
+	m_input_shown(false),
 	m_player_angle(360),
 	m_player_steps(0),
 	m_player_total_time(0),
@@ -61,34 +144,41 @@ Board::Board(QMainWindow* parent)
 	connect(qApp, SIGNAL(focusChanged(QWidget*, QWidget*)), this, SLOT(focusChanged()));
 	//setMinimumSize(800, 600); //TERJE GUNDERSEN
 	
-	m_move_animation = new QTimeLine(100, this);
-	m_move_animation->setFrameRange(0, 3);
-	m_move_animation->setCurveShape(QTimeLine::LinearCurve);
-	m_move_animation->setUpdateInterval(25);
-	connect(m_move_animation, SIGNAL(frameChanged(int)), this, SLOT(repaint()));
+	// Create frame clock that drives movement, animation, and status updates
+	m_frame_timer = new QTimer(this);
+	m_frame_timer->setSingleShot(true);
+	connect(m_frame_timer, SIGNAL(timeout()), this, SLOT(tick()));
+	m_frame_clock.start();
 
 	// Create status message
 	m_status_message = new QLabel;
 	parent->statusBar()->addPermanentWidget(m_status_message);
-	m_status_timer = new QTimer(this);
-	m_status_timer->setInterval(1000);
-	connect(m_status_timer, SIGNAL(timeout()), this, SLOT(updateStatusMessage()));
 
-	// <s> ADDED BY LARS PETTER MOSTAD
-	m_move_timer = new QTimer(this);
-	m_move_timer->setInterval(200);
-	connect(m_move_timer, SIGNAL(timeout()), this, SLOT(move()));
-	// </s>
+	// Setup background maze generation
+	m_generator = new Generator(this);
+	connect(m_generator, SIGNAL(finished()), this, SLOT(generated()));
+	m_next_generator = new Generator(this);
+	connect(m_next_generator, SIGNAL(finished()), this, SLOT(generated()));
+	m_generate_timer = new QTimer(this);
+	m_generate_timer->setInterval(100);
+	connect(m_generate_timer, SIGNAL(timeout()), this, SLOT(update()));
 
 	// Setup theme support
 	m_theme = new Theme;
 
-	// Start or load game
-	if (QSettings().contains("Current/Seed")) {
-		loadGame();
-	} else {
-		m_done = true;
-		newGame();
+	// Record games for replays when asked for
+	m_record_file = getenv("CUTEMAZE_RECORD");
+
+	// Play back replay given on the command line, or start or load game
+	QStringList arguments = qApp->arguments();
+	int replay = arguments.indexOf("--replay") + 1;
+	if (replay <= 0 || replay >= arguments.size() || !playReplay(arguments.at(replay))) {
+		if (QSettings().contains("Current/Seed")) {
+			loadGame();
+		} else {
+			m_done = true;
+			newGame();
+		}
 	}
 
 	loadSettings();
@@ -117,38 +207,75 @@ void Board::newGame()
 	}
 
 	// Stop tracking time
-	m_status_timer->stop();
-	m_move_timer->stop(); // ADDED BY LARS PETTER MOSTAD
+	setStatusClock(false);
+	setMoveClock(false); // ADDED BY LARS PETTER MOSTAD
 
-	// Fetch new seed
-	srand(time(0));
-	unsigned int seed = rand();
+	m_replaying = false;
+
+	// Fetch new seed, reusing the one of the pre-generated maze; calling
+	// rand() here would disturb the worker thread that is building it
+	unsigned int seed;
+	if (m_next_generator->isPending()) {
+		seed = m_next_generator->seed();
+	} else {
+		srand(time(0));
+		seed = rand();
+	}
 
 	// Set values for new game
 	QSettings settings;
+	m_journal.discard();
+	removeSaveFiles(settings);
 	settings.remove("Current");
 	settings.setValue("Current/Seed", seed);
+	bool large = settings.value("New/Large", false).toBool();
+	int maximum_targets = large ? Generator::MaximumTargets : 99;
 	m_total_targets = settings.value("New/Targets", 3).toInt();
 	m_total_targets = m_total_targets > 0 ? m_total_targets : 1;
-	m_total_targets = m_total_targets < 100 ? m_total_targets : 99;
+	m_total_targets = m_total_targets <= maximum_targets ? m_total_targets : maximum_targets;
 	settings.setValue("Current/Targets", m_total_targets);
 	settings.setValue("Current/Size", settings.value("New/Size", 50).toInt());
-	settings.setValue("Current/Algorithm", settings.value("New/Algorithm", 4).toInt());
+	if (large) {
+		settings.setValue("Current/Columns", settings.value("New/Columns", 512).toInt());
+		settings.setValue("Current/Rows", settings.value("New/Rows", 512).toInt());
+	}
+	int algorithm = settings.value("New/Algorithm", 4).toInt();
+	settings.setValue("Current/Algorithm", large ? Maze::largeAlgorithm(algorithm) : algorithm);
 	m_player_angle = 360;
 	m_player_steps = 0;
 
 	// Create new game
-	m_done = false;
+	m_loading = false;
 	generate(seed);
+}
+
+// ============================================================================
+
+void Board::startGame()
+{
+	m_done = false;
+	m_player_direction = 0;
+	m_player_firststep = true;
+
+	// Record inputs from the start, unless a replay is shown
+	m_moves = 0;
+	m_replay_event = 0;
+	m_recording = !m_replaying && !m_record_file.isEmpty();
+	if (m_recording) {
+		QSettings settings;
+		m_replay.start(settings.value("Current/Seed").toUInt(), settings.value("Current/Algorithm", 4).toInt(), m_maze->columns(), m_maze->rows(), m_total_targets);
+	}
+
 	saveGame();
 
 	// Begin tracking time
 	m_player_total_time = 0;
 	m_player_time.start();
-	m_status_timer->start();
-	m_move_timer->start(); // ADDED BY LARS PETTER MOSTAD
+	setStatusClock(true);
+	setMoveClock(true); // ADDED BY LARS PETTER MOSTAD
 	
 	// Show
+	updateRoute();
 	update();
 	updateStatusMessage();
 
@@ -159,6 +286,41 @@ void Board::newGame()
 
 // ============================================================================
 
+bool Board::playReplay(const QString& filename)
+{
+	if (!m_replay.load(filename)) {
+		QMessageBox::warning(this, tr("CuteMaze"), tr("Unable to load replay."));
+		return false;
+	}
+
+	// Stop tracking time
+	setStatusClock(false);
+	setMoveClock(false);
+
+	// Set values of replayed game, which replaces the current game
+	QSettings settings;
+	m_journal.discard();
+	removeSaveFiles(settings);
+	settings.remove("Current");
+	settings.setValue("Current/Seed", m_replay.seed());
+	settings.setValue("Current/Targets", m_replay.targets());
+	settings.setValue("Current/Size", m_replay.columns());
+	settings.setValue("Current/Columns", m_replay.columns());
+	settings.setValue("Current/Rows", m_replay.rows());
+	settings.setValue("Current/Algorithm", m_replay.algorithm());
+	m_total_targets = m_replay.targets();
+	m_player_angle = 360;
+	m_player_steps = 0;
+
+	// Create replayed game
+	m_loading = false;
+	m_replaying = true;
+	generate(m_replay.seed());
+	return true;
+}
+
+// ============================================================================
+
 void Board::loadGame()
 {
 	m_status_message->clear();
@@ -168,13 +330,34 @@ void Board::loadGame()
 	// Load maze
 	m_total_targets = settings.value("Current/Targets", 3).toInt();
 	m_total_targets = m_total_targets > 0 ? m_total_targets : 1;
-	m_total_targets = m_total_targets < 100 ? m_total_targets : 99;
+	m_total_targets = m_total_targets <= Generator::MaximumTargets ? m_total_targets : Generator::MaximumTargets;
+	m_loading = true;
 	generate(settings.value("Current/Seed").toUInt());
+}
+
+// ============================================================================
+
+void Board::resumeGame()
+{
+	QSettings settings;
+
+	// A game quit while its maze was generating was never saved, but its
+	// seed builds the same maze, so start that game over
+	if (!settings.contains("Current/SaveFile") && !settings.contains("Current/Progress")) {
+		m_replaying = false;
+		m_player_angle = 360;
+		m_player_steps = 0;
+		return startGame();
+	}
+
 	if (!m_maze->load()) {
 		QMessageBox::warning(this, tr("CuteMaze"), tr("Unable to load previous game. A new game will be started."));
 		m_done = true;
 		return newGame();
 	}
+	m_done = false;
+	m_recording = false;
+	m_replaying = false;
 
 	// Place player at last location
 	m_player = settings.value("Current/Player").toPoint();
@@ -183,25 +366,41 @@ void Board::loadGame()
 		m_player_angle = 360;
 	}
 	m_player_steps = settings.value("Current/Steps", 0).toInt();
+	m_player_total_time = settings.value("Current/Time", 0).toInt();
+
+	// Replay moves made after the last save, and keep adding to them
+	QString journal = journalFile(settings.value("Current/SaveFile").toString());
+	int replayed = m_journal.replay(journal, m_maze, m_player, m_player_angle, m_player_steps, m_player_total_time);
+	m_journal.open(journal, replayed);
 
 	// Resume tracking time
-	m_player_total_time = settings.value("Current/Time", 0).toInt();
 	m_player_time.start();
-	m_status_timer->start();
-	m_move_timer->start(); // ADDED BY LARS PETTER MOSTAD
+	setStatusClock(true);
+	setMoveClock(true); // ADDED BY LARS PETTER MOSTAD
+
+	// Fold replayed moves into a new save
+	if (replayed) {
+		saveGame();
+	}
 
 	// Remove any targets with matching movement
-	for (int i = 0; i < m_targets.size(); ++i) {
-		if (m_maze->cell(m_targets[i].x(), m_targets[i].y()).pathMarker() || m_player == m_targets[i]) {
-			m_targets.takeAt(i);
-			--i;
+	QList<QPoint> targets;
+	foreach (QPoint target, m_targets) {
+		if (!m_maze->cell(target.x(), target.y()).pathMarker() && m_player != target) {
+			targets.append(target);
 		}
 	}
+	m_targets = targets;
 
 	// Show
+	updateRoute();
 	update();
 	updateStatusMessage();
 
+	m_paused = false;
+	emit pauseAvailable(true);
+	emit pauseChecked(false);
+
 	// Should not happen, but handle a finished game
 	if (m_targets.isEmpty()) {
 		finish();
@@ -213,16 +412,56 @@ void Board::loadGame()
 void Board::saveGame()
 {
 	if (!m_done) {
-		m_maze->save();
+		// Write the maze beside the current save, which stays until the new
+		// one is complete; a journal left from an older save no longer fits
+		QString path = Maze::nextSaveFile();
+		QFile::remove(journalFile(path));
+		bool saved = m_maze->save(path);
+
+		// Point the settings at the new save and player together
 		QSettings settings;
-		settings.setValue("Current/Player", m_player);
-		settings.setValue("Current/Rotation", m_player_angle);
-		settings.setValue("Current/Steps", m_player_steps);
-		int msecs = m_player_total_time;
-		if (!m_paused) {
-			msecs += m_player_time.elapsed();
+		QVariant previous[saved_key_count];
+		for (int i = 0; i < saved_key_count; ++i) {
+			previous[i] = settings.value(saved_keys[i]);
+		}
+		if (saved) {
+			int msecs = m_player_total_time;
+			if (!m_paused) {
+				msecs += m_player_time.elapsed();
+			}
+			settings.setValue("Current/SaveFile", path);
+			settings.setValue("Current/Player", m_player);
+			settings.setValue("Current/Rotation", m_player_angle);
+			settings.setValue("Current/Steps", m_player_steps);
+			settings.setValue("Current/Time", msecs);
+			settings.sync();
+			saved = (settings.status() == QSettings::NoError);
+		}
+
+		if (saved) {
+			// Start a new journal for the moves after this save
+			settings.remove("Current/Progress");
+			m_journal.reset(journalFile(path));
+			QString previous_path = previous[0].toString();
+			if (!previous_path.isEmpty() && previous_path != path) {
+				QFile::remove(previous_path);
+				QFile::remove(journalFile(previous_path));
+			}
+		} else {
+			// Keep the previous save, and its journal, which goes on growing
+			qWarning("Unable to save game; moves are kept in the journal");
+			for (int i = 0; i < saved_key_count; ++i) {
+				if (previous[i].isValid()) {
+					settings.setValue(saved_keys[i], previous[i]);
+				} else {
+					settings.remove(saved_keys[i]);
+				}
+			}
+		}
+
+		if (m_recording) {
+			m_replay.save(m_record_file);
 		}
-		settings.setValue("Current/Time", msecs);
 	}
 }
 
@@ -232,13 +471,13 @@ void Board::pauseGame(bool paused)
 {
 	m_paused = paused;
 	if (paused) {
-		m_status_timer->stop();
-		m_move_timer->stop(); // ADDED BY LARS PETTER MOSTAD
+		setStatusClock(false);
+		setMoveClock(false); // ADDED BY LARS PETTER MOSTAD
 		m_player_total_time += m_player_time.elapsed();
 	} else {
 		m_player_time.start();
-		m_status_timer->start();
-		m_move_timer->start(); // ADDED BY LARS PETTER MOSTAD
+		setStatusClock(true);
+		setMoveClock(true); // ADDED BY LARS PETTER MOSTAD
 		updateStatusMessage();
 	}
 	update();
@@ -246,11 +485,37 @@ void Board::pauseGame(bool paused)
 
 // ============================================================================
 
+void Board::showOverview(bool show)
+{
+	m_show_overview = show;
+	update();
+}
+
+// ============================================================================
+
+void Board::showRoute(bool show)
+{
+	m_show_route = show;
+	updateRoute();
+	update();
+}
+
+// ============================================================================
+
+void Board::showStatistics(bool show)
+{
+	m_show_statistics = show;
+	update();
+}
+
+// ============================================================================
+
 void Board::loadSettings()
 {
 	QSettings settings;
 
 	// Load gameplay settings
+	advanceClock();
 	m_show_path = settings.value("Show Path", true).toBool();
 	m_show_steps = settings.value("Show Steps", true).toBool();
 	m_show_time = settings.value("Show Time", true).toBool();
@@ -264,11 +529,15 @@ void Board::loadSettings()
 	m_controls_flag = settings.value("Controls/Flag", Qt::Key_Space).toUInt();
 	m_controls_talk = settings.value("Controls/Talk", Qt::Key_Shift).toUInt(); // ADDED BY LARS PETTER MOSTAD
 	// Load theme
+	qint64 start = m_instrumentation.now();
 	m_theme->load(settings.value("Theme", "Mouse").toString());
+	recordTheme(start, settings.value("Theme", "Mouse").toString());
+	m_layer = QPixmap();
 
 	// Show
 	update();
 	updateStatusMessage();
+	scheduleTick();
 }
 
 // ============================================================================
@@ -276,13 +545,22 @@ void Board::loadSettings()
 // <s> CHANGED BY LARS PETTER MOSTAD
 void Board::keyPressEvent(QKeyEvent* event)
 {
-	// Prevent player from changing a paused or finished maze
-	if (m_done || m_paused) {
+	// Allow canceling a maze that is being generated
+	if (m_generating) {
+		if (event->key() == Qt::Key_Escape) {
+			cancelGeneration();
+		}
 		return;
 	}
 
-	// Prevent movement during animation
-	if (m_smooth_movement && m_move_animation->state() == QTimeLine::Running) {
+	// Prevent player from changing a paused or finished maze, or a replay
+	if (m_done || m_paused || m_replaying) {
+		return;
+	}
+
+	// Prevent movement during animation, except while gliding through a
+	// corridor, where the next step waits for the move clock anyway
+	if (m_smooth_movement && m_animation_time != -1 && m_animation_duration != move_interval) {
 		return;
 	}
 	
@@ -297,32 +575,42 @@ void Board::keyPressEvent(QKeyEvent* event)
 	m_player_firststep = true;
 	
 	unsigned int keypress = event->key();
+
+	// Measure time until the result of the key is shown
+	m_input_time = m_instrumentation.now();
 	
 	if (keypress == m_controls_left)
 	{
 		m_player_direction = 3;
+		recordInput(Replay::DirectionKey, 3);
 	}
 	else if(keypress == m_controls_right)
 	{
 		m_player_direction = 1;
+		recordInput(Replay::DirectionKey, 1);
 	}
 	else if(keypress == m_controls_up)
 	{
 		m_player_direction = 2;
+		recordInput(Replay::DirectionKey, 2);
 	}
 	else if(keypress == m_controls_down)
 	{
 		m_player_direction = 4;
+		recordInput(Replay::DirectionKey, 4);
 	}
 	else if(keypress == m_controls_flag)
 	{
-		m_maze->cellMutable(m_player.x(), m_player.y()).toggleFlag();
+		toggleFlag();
+		recordInput(Replay::FlagKey, 0);
+		m_input_shown = true;
 	}
 	else if(keypress == m_controls_talk)
 	{
+		recordInput(Replay::OtherKey, 0);
 		if(!recorder.isRunning())
 		{
-			m_move_timer->stop();
+			setMoveClock(false);
 			recorder.start();
 			QTime now = QTime::currentTime();
 			m_start_record_time = 60*1000*now.minute() + 1000*now.second() + now.msec();
@@ -331,8 +619,13 @@ void Board::keyPressEvent(QKeyEvent* event)
 	}
 	else
 	{
+		recordInput(Replay::OtherKey, 0);
+		m_input_time = -1;
 		return;
 	}
+
+	// Wake frame clock in case the player started moving
+	scheduleTick();
 }
 // </s>
 
@@ -343,6 +636,8 @@ void Board::keyReleaseEvent(QKeyEvent* event)
 {
 	if(event->key()==m_controls_talk && recorder.isRunning())
 	{
+		qint64 voice_start = m_instrumentation.now();
+
 		// we need to record for at least 1.2 seconds
 		int nowTime;
 		do
@@ -388,7 +683,9 @@ void Board::keyReleaseEvent(QKeyEvent* event)
 				qDebug(res[i].c_str());
 			}
 		}
-		m_move_timer->start();
+		recordInput(Replay::VoiceCommand, m_player_direction);
+		m_instrumentation.record(Instrumentation::Voice, m_instrumentation.now() - voice_start, QString("%1 words").arg(int(res.size())));
+		setMoveClock(true);
 	}
 }
 // </s>
@@ -408,13 +705,13 @@ void Board::mousePressEvent(QMouseEvent* event)
 	*/
 	//first_mouse_click = (first_mouse_click == false) ? true : false;
 
-	// Prevent player from changing a paused or finished maze
-	if (m_done || m_paused) {
+	// Prevent player from changing a paused or finished maze, or a replay
+	if (m_done || m_paused || m_replaying) {
 		return;
 	}
 	
 	// Prevent movement during animation
-	if (m_smooth_movement && m_move_animation->state() == QTimeLine::Running) {
+	if (m_smooth_movement && m_animation_time != -1) {
 		return;
 	}
 	
@@ -426,7 +723,7 @@ void Board::mousePressEvent(QMouseEvent* event)
 	// Click the mouse to start recording
 	if (!recorder.isRunning()) 
 	{	
-		m_move_timer->stop();
+		setMoveClock(false);
 		recorder.start();
 		QTime now = QTime::currentTime();
 		m_start_record_time = 60*1000*now.minute() + 1000*now.second() + now.msec();
@@ -442,6 +739,8 @@ void Board::mouseReleaseEvent(QMouseEvent* event)
 {
 	if(recorder.isRunning())
 	{
+		qint64 voice_start = m_instrumentation.now();
+
 		// we need to record for at least 1.2 seconds
 		int nowTime;
 		do
@@ -487,23 +786,47 @@ void Board::mouseReleaseEvent(QMouseEvent* event)
 				qDebug(res[i].c_str());
 			}
 		}
-		m_move_timer->start();
+		recordInput(Replay::VoiceCommand, m_player_direction);
+		m_instrumentation.record(Instrumentation::Voice, m_instrumentation.now() - voice_start, QString("%1 words").arg(int(res.size())));
+		setMoveClock(true);
 	}
 }
 // </s>
 // ============================================================================
 
-void Board::paintEvent(QPaintEvent*)
+void Board::paintEvent(QPaintEvent* event)
 {
-	if (!m_paused) {
+	m_instrumentation.wakeup(Instrumentation::PaintWakeup);
+	qint64 start = m_instrumentation.now();
+
+	if (m_generating || !m_maze) {
+		renderGenerating();
+	} else if (!m_paused) {
 		if (!m_done) {
-			renderMaze(m_move_animation->currentFrame());
+			if (m_show_overview) {
+				renderOverview();
+			} else {
+				renderMaze(animationProgress(), event->rect());
+			}
 		} else {
 			renderDone();
 		}
 	} else {
 		renderPause();
 	}
+
+	if (m_show_statistics) {
+		renderStatistics();
+	}
+
+	// Record how long painting, and the last key press until it was shown, took
+	qint64 end = m_instrumentation.now();
+	m_instrumentation.record(Instrumentation::Frame, end - start);
+	if (m_input_shown) {
+		m_instrumentation.record(Instrumentation::Latency, end - m_input_time);
+		m_input_time = -1;
+		m_input_shown = false;
+	}
 }
 
 // ============================================================================
@@ -525,7 +848,10 @@ void Board::resizeEvent(QResizeEvent*)
 //	<s> ADDED BY Mehdi Soufifar
 	m_unit = 1* 32;
 //	</s> 
+	qint64 start = m_instrumentation.now();
 	m_theme->scale(m_unit);
+	recordTheme(start, QString("unit %1").arg(m_unit));
+	m_layer = QPixmap();
 }
 
 // ============================================================================
@@ -565,111 +891,203 @@ void Board::updateStatusMessage()
 
 // ============================================================================
 
-// <s> ADDED BY LARS PETTER MOSTAD
-// Based on old keyPressEvent()
-void Board::move()
+void Board::tick()
 {
-	if(m_player_direction == 0)
-		return;
+	m_instrumentation.wakeup(Instrumentation::TimerWakeup);
 
-	// Prevent movement during animation
-	if (m_smooth_movement && m_move_animation->state() == QTimeLine::Running) {
-		return;
+	bool animating = (m_animation_time != -1);
+	advanceClock();
+	if (animating) {
+		update();
 	}
 
-	m_col_delta = m_row_delta = 0;
-	QPoint position = m_player;
-	const Cell& cell = m_maze->cell(m_player.x(), m_player.y());
-
-	if(m_player_direction == 3)
-	{
-		m_player_angle = 270;
-		// See report for algorithm description
-		if( !cell.leftWall() && ( m_player_firststep || !cell.isFork() ) )
-		{
-			Q_ASSERT(m_player.x() > 0);m_player.rx()--;
-			const Cell& cell2 = m_maze->cell(m_player.x(), m_player.y());
-			if(!cell2.leftWall())
-				m_player_direction = 3;
-			else if(!cell2.bottomWall())
-				m_player_direction = 4;
-			else if(!cell2.topWall())
-				m_player_direction = 2;
-			else
-				m_player_direction = 0;
+	// Step player at a fixed rate, dropping steps that were missed
+	if (m_move_clock && m_move_time >= move_interval) {
+		m_move_time = qMin(m_move_time - move_interval, move_interval - 1);
+		if (!m_replaying || replayInputs()) {
+			move();
 		}
-		else
-		{
-			m_player_direction = 0;
+	}
+
+	// Refresh status message once a second
+	if (m_status_clock && m_show_time && m_status_time >= status_interval) {
+		m_status_time = qMin(m_status_time - status_interval, status_interval - 1);
+		updateStatusMessage();
+	}
+
+	scheduleTick();
+}
+
+// ============================================================================
+
+void Board::advanceClock()
+{
+	int elapsed = m_frame_clock.restart();
+	if (m_animation_time != -1) {
+		m_animation_time += elapsed;
+		if (m_animation_time >= m_animation_duration) {
+			m_animation_time = -1;
 		}
 	}
-	else if(m_player_direction == 1)
-	{
-		m_player_angle = 90;
-		if( !cell.rightWall() && ( m_player_firststep || !cell.isFork() ) )
-		{
-			Q_ASSERT(m_player.x() < m_maze->columns() - 1);m_player.rx()++;
-			const Cell& cell2 = m_maze->cell(m_player.x(), m_player.y());
-			if(!cell2.rightWall())
-				m_player_direction = 1;
-			else if(!cell2.bottomWall())
-				m_player_direction = 4;
-			else if(!cell2.topWall())
-				m_player_direction = 2;
-			else
-				m_player_direction = 0;
+	// Parked clocks fire as soon as they are woken
+	if (m_move_clock) {
+		m_move_time += elapsed;
+		if (m_player_direction == 0 && m_move_time > move_interval) {
+			m_move_time = move_interval;
 		}
-		else
-		{
-			m_player_direction = 0;
+	}
+	if (m_status_clock) {
+		m_status_time += elapsed;
+		if (!m_show_time && m_status_time > status_interval) {
+			m_status_time = status_interval;
 		}
-	} 
-	else if(m_player_direction == 2)
-	{
-		m_player_angle = 360;
-		if( !cell.topWall() && ( m_player_firststep || !cell.isFork() ) )
-		{
-			Q_ASSERT(m_player.y() > 0);m_player.ry()--;
-			const Cell& cell2 = m_maze->cell(m_player.x(), m_player.y());
-			if(!cell2.leftWall())
-				m_player_direction = 3;
-			else if(!cell2.topWall())
-				m_player_direction = 2;
-			else if(!cell2.rightWall())
-				m_player_direction = 1;
-			else
-				m_player_direction = 0;
+	}
+}
+
+// ============================================================================
+
+void Board::scheduleTick()
+{
+	// Tick every frame while animating, otherwise sleep until the next step;
+	// park when the player is standing still and no time is shown
+	int interval = -1;
+	if (m_animation_time != -1) {
+		interval = frame_interval;
+	} else {
+		if (m_move_clock && (m_player_direction != 0 || m_replaying)) {
+			interval = move_interval - m_move_time;
 		}
-		else
-		{
-			m_player_direction = 0;
+		if (m_status_clock && m_show_time) {
+			int status = status_interval - m_status_time;
+			interval = (interval == -1 || status < interval) ? status : interval;
 		}
 	}
-	else if(m_player_direction == 4)
-	{
-		m_player_angle = 180;
-		if( !cell.bottomWall() && ( m_player_firststep || !cell.isFork() ) )
-		{
-			Q_ASSERT(m_player.y() < m_maze->rows() - 1);m_player.ry()++;
-			const Cell& cell2 = m_maze->cell(m_player.x(), m_player.y());
-			if(!cell2.leftWall())
-				m_player_direction = 3;
-			else if(!cell2.bottomWall())
-				m_player_direction = 4;
-			else if(!cell2.rightWall())
-				m_player_direction = 1;
-			else
-				m_player_direction = 0;
+
+	if (interval == -1) {
+		m_frame_timer->stop();
+	} else {
+		interval -= m_frame_clock.elapsed();
+		m_frame_timer->start(interval > 0 ? interval : 0);
+	}
+}
+
+// ============================================================================
+
+void Board::setMoveClock(bool run)
+{
+	advanceClock();
+	m_move_clock = run;
+	m_move_time = 0;
+	scheduleTick();
+}
+
+// ============================================================================
+
+void Board::setStatusClock(bool run)
+{
+	advanceClock();
+	m_status_clock = run;
+	m_status_time = 0;
+	scheduleTick();
+}
+
+// ============================================================================
+
+qreal Board::animationProgress() const
+{
+	if (m_animation_time == -1) {
+		return 1.0;
+	}
+	qreal progress = (m_animation_time + m_frame_clock.elapsed()) / qreal(m_animation_duration);
+	return progress < 1.0 ? progress : 1.0;
+}
+
+// ============================================================================
+
+void Board::toggleFlag()
+{
+	m_maze->cellMutable(m_player.x(), m_player.y()).toggleFlag();
+	m_overview.updateCell(m_player);
+	m_journal.recordFlag(m_player, m_player_total_time + m_player_time.elapsed());
+	if (m_show_overview) {
+		update();
+	} else {
+		updateCell(m_player);
+	}
+}
+
+// ============================================================================
+
+void Board::updateRoute()
+{
+	m_route.clear();
+	if (!m_show_route || m_done || !m_maze || m_targets.isEmpty()) {
+		return;
+	}
+
+	// Lead to the first target of the shortest walk collecting them all
+	QList<QPoint> targets = m_solver.route(m_player, m_targets);
+	if (!targets.isEmpty()) {
+		m_route = m_solver.path(m_player, targets.first());
+	}
+}
+
+// ============================================================================
+
+void Board::recordInput(Replay::EventType type, int value)
+{
+	if (m_recording) {
+		m_replay.record(m_moves, m_player_total_time + m_player_time.elapsed(), type, value);
+	}
+}
+
+// ============================================================================
+
+bool Board::replayInputs()
+{
+	// Apply inputs made before the next move, waiting until they are due
+	const QVector<Replay::Event>& events = m_replay.events();
+	int msecs = m_player_total_time + m_player_time.elapsed();
+	for (; m_replay_event < events.size() && events.at(m_replay_event).moves <= m_moves; ++m_replay_event) {
+		const Replay::Event& event = events.at(m_replay_event);
+		if (event.msecs > msecs) {
+			return false;
 		}
-		else
-		{
-			m_player_direction = 0;
+		if (event.type != Replay::VoiceCommand) {
+			m_player_firststep = true;
+		}
+		if (event.type == Replay::DirectionKey || event.type == Replay::VoiceCommand) {
+			m_player_direction = event.value;
+		} else if (event.type == Replay::FlagKey) {
+			toggleFlag();
 		}
 	}
-	else
-	{
+
+	// Hand the game to the player once the replay runs out
+	if (m_replay_event == events.size() && m_player_direction == 0) {
+		m_replaying = false;
+	}
+	return true;
+}
+
+// ============================================================================
+
+// <s> ADDED BY LARS PETTER MOSTAD
+// Based on old keyPressEvent()
+void Board::move()
+{
+	if(m_player_direction == 0)
+		return;
+
+	// Prevent movement during animation
+	if (m_smooth_movement && m_animation_time != -1) {
 		return;
 	}
+
+	m_moves++;
+	m_col_delta = m_row_delta = 0;
+	QPoint position = m_player;
+	m_player_angle = stepPlayer(m_maze, m_corridors, m_player_run, m_player, m_player_direction, m_player_firststep);
 	m_player_firststep = false;
 	// Handle player movement
 	if (position != m_player) {
@@ -677,18 +1095,36 @@ void Board::move()
 		m_col_delta = m_player.x() - position.x();
 		m_row_delta = m_player.y() - position.y();
 		if (m_smooth_movement) {
-			m_move_animation->start();
+			// Inside a corridor the next step is already known, so glide for
+			// the whole step, ending as the move clock takes the next one,
+			// instead of stopping at every cell until the next fork
+			advanceClock();
+			if (m_player_run.remaining && m_move_clock) {
+				m_animation_duration = move_interval;
+				m_animation_time = m_move_time;
+			} else {
+				m_animation_duration = animation_duration;
+				m_animation_time = 0;
+			}
+			scheduleTick();
 		}
 
 		// Add path marker
+		int angle = 0;
 		if (m_maze->cell(position.x(), position.y()).pathMarker() == 0) {
-			int angle = 0;
 			if (m_col_delta) {
 				angle = 180 - (m_col_delta * 90);
 			} else {
 				angle = 360 - ((m_row_delta + 1) * 90);
 			}
 			m_maze->cellMutable(position.x(), position.y()).setPathMarker(angle);
+			m_overview.updateCell(position);
+		}
+
+		// Journal step, and save the maze each time the journal grows long
+		m_journal.recordMove(m_player, angle, m_player_angle, m_player_total_time + m_player_time.elapsed());
+		if (m_journal.size() && (m_journal.size() % journal_limit == 0)) {
+			saveGame();
 		}
 	}
 
@@ -699,15 +1135,36 @@ void Board::move()
 			--i;
 		}
 	}
+
+	// Follow the route; the maze is a tree, so a step off it only adds the
+	// way back, while reaching the target needs a new order for the rest
+	if (m_show_route && position != m_player) {
+		if (m_route.size() > 2 && m_route.at(1) == m_player) {
+			m_route.removeFirst();
+		} else if (!m_route.isEmpty() && m_route.first() == position && m_targets.contains(m_route.last())) {
+			m_route.prepend(m_player);
+		} else {
+			updateRoute();
+		}
+	}
 	
 	
-	// Show updated maze
-	update();
+	if (m_input_time != -1) {
+		m_input_shown = true;
+	}
+
+	// Show updated maze; a step scrolls the whole view, a turn only changes the player
+	if (position != m_player || m_show_overview) {
+		update();
+	} else {
+		updateCell(m_player);
+	}
 	updateStatusMessage();
 
 	// Handle finishing a maze
 	if (m_targets.isEmpty()) {
 		m_maze->cellMutable(m_player.x(), m_player.y()).setPathMarker(m_player_angle);
+		m_overview.updateCell(m_player);
 		finish();
 	}
 }
@@ -717,79 +1174,110 @@ void Board::move()
 
 void Board::generate(unsigned int seed)
 {
-	int columns = QSettings().value("Current/Size", 50).toInt();
-	columns = columns > 9 ? columns : 10;
-	columns = columns < 100 ? columns : 99;
-	int rows = columns;
+	QSettings settings;
+	int algorithm = settings.value("Current/Algorithm", 4).toInt();
+	int columns, rows;
+	currentSize(settings, columns, rows);
+	m_total_targets = m_total_targets < columns * rows ? m_total_targets : columns * rows - 1;
 
-	// Create new maze
+	// Build new maze in the background; the current one stays until it is done
+	m_done = true;
+	m_generating = true;
 	m_targets.clear();
-	srand(seed);
+	emit pauseAvailable(false);
+
+	// Take the maze pre-generated after the last game if it matches
+	bool hit = !m_loading && (m_next_generator->seed() == seed) && m_next_generator->matches(algorithm, columns, rows, m_total_targets);
+	if (!m_loading) {
+		m_instrumentation.pregenerated(hit);
+	}
+	if (hit) {
+		qSwap(m_generator, m_next_generator);
+	} else {
+		m_next_generator->cancel();
+		m_next_generator->wait();
+		m_generator->generate(seed, algorithm, columns, rows, m_total_targets);
+	}
+
+	// Show
+	if (m_generator->isReady()) {
+		generated();
+	} else {
+		m_generate_timer->start();
+		m_status_message->setText(tr("Generating maze, press Escape to cancel"));
+		update();
+	}
+}
+
+// ============================================================================
+
+void Board::pregenerate()
+{
+	QSettings settings;
+	int algorithm = settings.value("Current/Algorithm", 4).toInt();
+	int columns, rows;
+	currentSize(settings, columns, rows);
+
+	// Players usually start another game with the same settings right away
+	srand(time(0));
+	m_next_generator->generate(rand(), algorithm, columns, rows, m_total_targets);
+}
+
+// ============================================================================
+
+void Board::generated()
+{
+	// Ignore canceled mazes and signals from replaced ones
+	if (!m_generator->isReady()) {
+		return;
+	}
+	m_generator->wait();
+	m_generating = false;
+	m_generate_timer->stop();
+
+	// Swap in new maze
 	delete m_maze;
-	switch (QSettings().value("Current/Algorithm", 4).toInt()) {
-	case 0:
-		m_maze = new HuntAndKillMaze;
-		break;
-	case 1:
-		m_maze = new KruskalMaze;
-		break;
-	case 2:
-		m_maze = new PrimMaze;
-		break;
-	case 3:
-		m_maze = new RecursiveBacktrackerMaze;
-		break;
-	case 5:
-		m_maze = new Stack2Maze;
-		break;
-	case 6:
-		m_maze = new Stack3Maze;
-		break;
-	case 7:
-		m_maze = new Stack4Maze;
-		break;
-	case 8:
-		m_maze = new Stack5Maze;
-		break;
-	case 4:
-	default:
-		m_maze = new StackMaze;
-		break;
-	}
-	m_maze->generate(columns, rows);
-
-	// Add player
-	m_player.setX(rand() % (columns - 1));
-	m_player.setY(rand() % (rows - 1));
-	m_start = m_player;
-
-	// Add targets
-	QList<QPoint> locations;
-	if (columns * rows > m_total_targets * 2) {
-		locations.append(m_start);
-		QPoint target;
-		for (int i = 0; i < m_total_targets; ++i) {
-			do {
-				target.setX(rand() % (columns - 1));
-				target.setY(rand() % (rows - 1));
-			} while (locations.contains(target));
-			locations.append(target);
-			m_targets.append(target);
-		}
-	// Handle if targets cover half or more of the maze
+	m_layer = QPixmap();
+	m_maze = m_generator->takeMaze();
+	m_overview.setMaze(m_maze);
+	m_start = m_generator->startLocation();
+	m_player = m_start;
+	m_targets = m_generator->targets();
+	m_optimal_steps = m_generator->optimalSteps();
+	m_corridors = m_generator->corridors();
+	m_solver = m_generator->solver();
+	m_route.clear();
+	m_status_message->clear();
+	m_instrumentation.record(Instrumentation::Generation, qint64(m_maze->generationTime()) * 1000,
+		QString("algorithm %1 %2x%3 peak %4 KB").arg(QSettings().value("Current/Algorithm", 4).toInt()).arg(m_maze->columns()).arg(m_maze->rows()).arg(m_maze->peakMemory()));
+
+	if (m_loading) {
+		resumeGame();
 	} else {
-		for (int c = 0; c < columns; ++c) {
-			for (int r = 0; r < rows; ++r) {
-				locations.append(QPoint(c, r));
-			}
-		}
-		locations.removeAll(m_player);
-		int pos;
-		for (int i = 0; i < m_total_targets; ++i) {
-			pos = rand() % locations.size();
-			m_targets.append(locations.takeAt(pos));
-		}
+		startGame();
 	}
+	m_player_run = m_corridors.locate(m_maze, m_player);
+}
+
+// ============================================================================
+
+void Board::cancelGeneration()
+{
+	m_generator->cancel();
+	m_generator->wait();
+	m_generating = false;
+	m_generate_timer->stop();
+
+	// A new game that never started can not be resumed
+	if (!m_loading) {
+		QSettings().remove("Current");
+	}
+
+	m_overview.setMaze(0);
+	delete m_maze;
+	m_maze = 0;
+	m_status_message->clear();
+	update();
 }
 
 // ============================================================================
@@ -797,8 +1285,8 @@ void Board::generate(unsigned int seed)
 void Board::finish()
 {
 	emit pauseAvailable(false);
-	m_move_animation->stop();
-	m_move_animation->setCurrentTime(m_move_animation->duration());
+	m_animation_time = -1;
+	m_route.clear();
 
 	QSettings settings;
 	settings.beginGroup("Current");
@@ -806,15 +1294,27 @@ void Board::finish()
 	// Get score values
 	int seconds = (m_player_total_time + m_player_time.elapsed()) / 1000;
 	int algorithm = settings.value("Algorithm").toInt();
-	int size = settings.value("Size").toInt();
+	settings.endGroup();
+
+	// Build the next maze while the player looks at the score
+	pregenerate();
+
+	// Keep finished replay
+	if (m_recording) {
+		m_replay.finish(m_player_steps, m_player_total_time + m_player_time.elapsed());
+		m_replay.save(m_record_file);
+		m_recording = false;
+	}
 
 	// Remove game from disk
 	m_done = true;
-	settings.remove("");
+	m_journal.discard();
+	removeSaveFiles(settings);
+	settings.remove("Current");
 
 	// Show congratulations
-	m_status_timer->stop();
-	m_move_timer->stop(); // ADDED BY LARS PETTER MOSTAD
+	setStatusClock(false);
+	setMoveClock(false); // ADDED BY LARS PETTER MOSTAD
 	update();
 
 	QString time;
@@ -834,14 +1334,100 @@ void Board::finish()
 		m_status_message->setText(tr("Success!"));
 	}
 
-	// Add high score
-	emit finished(m_player_steps, seconds, algorithm, size);
+	// Add high score, unless the game was a replay
+	if (m_replaying) {
+		m_replaying = false;
+	} else {
+		emit finished(m_player_steps, seconds, algorithm, m_maze->columns(), m_maze->rows(), m_optimal_steps);
+	}
 }
 
 // ============================================================================
 
+void Board::updateCell(const QPoint& cell)
+{
+	// Cells are three units apart, with walls and corners reaching one unit
+	// before them; the player is always drawn at column 5 and row 4
+	int x = (cell.x() - m_player.x() + 5) * 3 - 4;
+	int y = (cell.y() - m_player.y() + 4) * 3 - 4;
+	update(x * m_unit, y * m_unit, m_unit * 4, m_unit * 4);
+}
+
+// ============================================================================
 
-void Board::renderMaze(int frame)
+void Board::renderLayer()
+{
+	// Cover the visible cells and a margin around them, so that the player
+	// can take a few steps before the layer has to be rebuilt
+	int cells = 11 + layer_margin * 2;
+	int pitch = m_unit * 3;
+	int columns = m_maze->columns();
+	int rows = m_maze->rows();
+	m_layer_origin = QPoint(m_player.x() - 5 - layer_margin, m_player.y() - 4 - layer_margin);
+	m_layer = QPixmap(cells * pitch + m_unit, cells * pitch + m_unit);
+	m_layer.fill(palette().color(QPalette::Window));
+
+	// Walls and corners reach one unit before their cell
+	QPainter painter(&m_layer);
+	painter.translate(m_unit, m_unit);
+
+	// Draw background
+	for (int r = 0; r < cells; ++r) {
+		for (int c = 0; c < cells; ++c) {
+			m_theme->batch(c, r, Theme::Background);
+		}
+	}
+
+	// Draw walls
+	QVector<unsigned char> corners((cells + 1) * (cells + 1), 0);
+	for (int r = 0; r < cells; ++r) {
+		int row = m_layer_origin.y() + r;
+		if (row < 0 || row >= rows) {
+			continue;
+		}
+		for (int c = 0; c < cells; ++c) {
+			int column = m_layer_origin.x() + c;
+			if (column < 0 || column >= columns) {
+				continue;
+			}
+
+			const Cell& cell = m_maze->cell(column, row);
+			if (cell.topWall()) {
+				m_theme->batchWall(c, r);
+			}
+			if (cell.leftWall()) {
+				m_theme->batchWall(c, r, true);
+			}
+			if (column + 1 == columns) {
+				m_theme->batchWall(c + 1, r, true);
+			}
+			if (row + 1 == rows) {
+				m_theme->batchWall(c, r + 1);
+			}
+
+			// Configure corners
+			corners[r * (cells + 1) + c] |= (cell.topWall() << 1) | (cell.leftWall() << 2);
+			corners[r * (cells + 1) + c + 1] |= (cell.topWall() << 3) | (cell.rightWall() << 2);
+			corners[(r + 1) * (cells + 1) + c + 1] |= (cell.rightWall() << 0) | (cell.bottomWall() << 3);
+			corners[(r + 1) * (cells + 1) + c] |= (cell.leftWall() << 0) | (cell.bottomWall() << 1);
+		}
+	}
+
+	// Draw corners
+	for (int r = 0; r <= cells; ++r) {
+		for (int c = 0; c <= cells; ++c) {
+			unsigned char walls = corners[r * (cells + 1) + c];
+			if (walls) {
+				m_theme->batchCorner(c, r, walls);
+			}
+		}
+	}
+	m_theme->drawBatch(painter);
+}
+
+// ============================================================================
+
+void Board::renderMaze(qreal progress, const QRect& area)
 {
 	int column = m_player.x() - m_col_delta - 5;
 	int row = m_player.y() - m_row_delta - 4;
@@ -852,8 +1438,14 @@ void Board::renderMaze(int frame)
 	Q_ASSERT(m_player.x() < columns);
 	Q_ASSERT(m_player.y() > -1);
 	Q_ASSERT(m_player.y() < rows);
-	Q_ASSERT(frame > -1);
-	Q_ASSERT(frame < 5);
+	Q_ASSERT(progress >= 0.0);
+	Q_ASSERT(progress <= 1.0);
+
+	// Rebuild static layer when the view nears its edge
+	int cells = 11 + layer_margin * 2;
+	if (m_layer.isNull() || !QRect(m_layer_origin, QSize(cells, cells)).contains(QRect(column - 1, row - 1, 13, 13))) {
+		renderLayer();
+	}
 
 	// Create painter
 	QPainter painter(this);
@@ -862,103 +1454,48 @@ void Board::renderMaze(int frame)
 	painter.setClipRect(0,0, size, size_y); // added by Terje Gundersen
 	painter.translate(-3 * m_unit, -3 * m_unit);
 
-	// Shift by frame amount
+	// Shift by fraction of a cell moved
 	painter.save();
-	int delta = frame * -m_unit;
+	int delta = qRound(progress * -3 * m_unit);
 	if (!m_smooth_movement) {
 		delta = -3 * m_unit;
 	}
 	painter.translate(delta * m_col_delta, delta * m_row_delta);
 
-	// Draw background
-	for (int r = 0; r < 11; ++r) {
-		for (int c = 0; c < 11; ++c) {
-			m_theme->draw(painter, c, r, Theme::Background);
-		}
-	}
+	// Only draw cells that overlap the area being repainted
+	QRect dirty = area.translated(3 * m_unit - delta * m_col_delta, 3 * m_unit - delta * m_row_delta);
+	QRect cell_bounds(-m_unit, -m_unit, m_unit * 4, m_unit * 4);
+	int pitch = m_unit * 3;
 
-	// Initialize corners
-	unsigned char corners[11][11];
-	for (int r = 0; r < 11; ++r) {
-		for (int c = 0; c < 11; ++c) {
-			corners[c][r] = 0;
-		}
-	}
-
-	// Setup columns
-	int column_start = 0;
-	int column_count = 10;
-	if (column < 1) {
-		column_start = abs(column);
-	} else if (column + 9 >= columns) {
-		column_count = columns - column;
-	}
-
-	// Setup rows
-	int row_start = 0;
-	int row_count = 10;
-	if (row < 1) {
-		row_start = abs(row);
-	} else if (row + 9 >= rows) {
-		row_count = rows - row;
-	}
+	// Draw background, walls, and corners
+	QPoint offset((m_layer_origin.x() - column) * pitch - m_unit, (m_layer_origin.y() - row) * pitch - m_unit);
+	QRect layer_area = dirty & QRect(offset, m_layer.size());
+	painter.drawPixmap(layer_area, m_layer, layer_area.translated(-offset));
 
-	// Draw cells
+	// Draw markers and flags
 	int angle = 0;
-	for (int r = row_start; r < row_count; ++r) {
-		for (int c = column_start; c < column_count; ++c) {
+	for (int r = 0; r < 10; ++r) {
+		if (row + r < 0 || row + r >= rows) {
+			continue;
+		}
+		for (int c = 0; c < 10; ++c) {
+			if (column + c < 0 || column + c >= columns || !dirty.intersects(cell_bounds.translated(c * pitch, r * pitch))) {
+				continue;
+			}
 
 			const Cell& cell = m_maze->cell(column + c, row + r);
 
-			// Draw walls
-			if (cell.topWall()) {
-				m_theme->drawWall(painter, c, r);
-			}
-			if (cell.leftWall()) {
-				m_theme->drawWall(painter, c, r, true);
-			}
-			if (column + c + 1 == columns) {
-				m_theme->drawWall(painter, c + 1, r, true);
-			}
-			if (row + r + 1 == rows) {
-				m_theme->drawWall(painter, c, r + 1);
-			}
-
 			// Draw marker
 			if (m_show_path) {
 				angle = cell.pathMarker();
 				if (angle) {
-					m_theme->draw(painter, c, r, Theme::Marker, angle);
+					m_theme->batch(c, r, Theme::Marker, angle);
 				}
 			}
 
 			// Draw flag
 			if (cell.flag()) {
-				m_theme->draw(painter, c, r, Theme::Flag);
-			}
-
-			// Configure corners
-			unsigned char& corner1 = corners[c][r];
-			corner1 |= (cell.topWall() << 1);
-			corner1 |= (cell.leftWall() << 2);
-			unsigned char& corner2 = corners[c + 1][r];
-			corner2 |= (cell.topWall() << 3);
-			corner2 |= (cell.rightWall() << 2);
-			unsigned char& corner3 = corners[c + 1][r + 1];
-			corner3 |= (cell.rightWall() << 0);
-			corner3 |= (cell.bottomWall() << 3);
-			unsigned char& corner4 = corners[c][r + 1];
-			corner4 |= (cell.leftWall() << 0);
-			corner4 |= (cell.bottomWall() << 1);
-		}
-	}
-
-	// Draw corners
-	for (int r = 0; r < 11; ++r) {
-		for (int c = 0; c < 11; ++c) {
-			unsigned char walls = corners[c][r];
-			if (walls) {
-				m_theme->drawCorner(painter, c, r, walls);
+				m_theme->batch(c, r, Theme::Flag);
 			}
 		}
 	}
@@ -966,13 +1503,36 @@ void Board::renderMaze(int frame)
 	// Draw start
 	QRect view(column, row, 10, 10);
 	if (view.contains(m_start)) {
-		m_theme->draw(painter, m_start.x() - column, m_start.y() - row, Theme::Start);
+		m_theme->batch(m_start.x() - column, m_start.y() - row, Theme::Start);
 	}
 
 	// Draw targets
 	foreach (QPoint target, m_targets) {
 		if (view.contains(target)) {
-			m_theme->draw(painter, target.x() - column, target.y() - row, Theme::Target);
+			m_theme->batch(target.x() - column, target.y() - row, Theme::Target);
+		}
+	}
+	m_theme->drawBatch(painter);
+
+	// Draw route through the cell centers, splitting it where it leaves the view
+	if (m_show_route && !m_route.isEmpty()) {
+		QColor color = palette().color(QPalette::Highlight);
+		color.setAlpha(160);
+		painter.setRenderHint(QPainter::Antialiasing);
+		painter.setPen(QPen(color, qMax(1, m_unit / 2), Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin));
+		QRect route_view(column - 1, row - 1, 12, 12);
+		QPoint center(m_unit, m_unit);
+		QVector<QPoint> line;
+		foreach (const QPoint& cell, m_route) {
+			if (route_view.contains(cell)) {
+				line.append((cell - QPoint(column, row)) * pitch + center);
+			} else if (!line.isEmpty()) {
+				painter.drawPolyline(line.constData(), line.size());
+				line.clear();
+			}
+		}
+		if (!line.isEmpty()) {
+			painter.drawPolyline(line.constData(), line.size());
 		}
 	}
 
@@ -995,6 +1555,12 @@ void Board::renderDone()
 	cell_width -= (mcr + 1);
 	cell_width /= mcr;
 	cell_width += 1;
+
+	// Drawing each wall is too slow for large mazes
+	if (cell_width < 4) {
+		renderOverview(tr("Success"));
+		return;
+	}
 	int w = columns * cell_width + 1;
 	int h = rows * cell_width + 1;
 
@@ -1032,6 +1598,42 @@ void Board::renderDone()
 
 // ============================================================================
 
+void Board::renderOverview(const QString& message)
+{
+	QPainter painter(this);
+	int size = m_unit * 26;
+	int size_y = m_unit * 19.5;
+	painter.fillRect(0, 0, size, size_y, Qt::white);
+	m_overview.draw(painter, QRect(0, 0, size, size_y), m_player, m_targets);
+
+	// Draw message
+	if (!message.isEmpty()) {
+		renderText(&painter, message);
+	}
+}
+
+// ============================================================================
+
+void Board::renderStatistics()
+{
+	QPainter painter(this);
+	painter.setFont(QFont("Monospace", 9));
+	QStringList lines = m_instrumentation.summary();
+	int line_height = painter.fontMetrics().height();
+	int box_width = 0;
+	foreach (const QString& line, lines) {
+		box_width = qMax(box_width, painter.fontMetrics().width(line));
+	}
+
+	painter.fillRect(0, 0, box_width + 10, lines.size() * line_height + 10, QColor(0, 0, 0, 200));
+	painter.setPen(Qt::white);
+	for (int i = 0; i < lines.size(); ++i) {
+		painter.drawText(5, 5 + painter.fontMetrics().ascent() + i * line_height, lines.at(i));
+	}
+}
+
+// ============================================================================
+
 void Board::renderPause()
 {
 	// Create painter
@@ -1051,6 +1653,23 @@ void Board::renderPause()
 
 // ============================================================================
 
+void Board::renderGenerating()
+{
+	QPainter painter(this);
+	int size = m_unit * 26;
+	int size_y = m_unit * 19.5;
+	painter.fillRect(0, 0, size, size_y, Qt::white);
+
+	// Draw message
+	if (m_generating) {
+		renderText(&painter, tr("Generating %1%").arg(m_generator->progress()));
+	} else {
+		renderText(&painter, tr("Canceled"));
+	}
+}
+
+// ============================================================================
+
 void Board::renderText(QPainter* painter, const QString& message) const
 {
 	painter->setFont(QFont("Sans", 24));
@@ -1072,3 +1691,16 @@ void Board::renderText(QPainter* painter, const QString& message) const
 }
 
 // ============================================================================
+
+void Board::recordTheme(qint64 start, const QString& details)
+{
+	m_instrumentation.record(Instrumentation::ThemeScale, m_instrumentation.now() - start, details);
+
+	// Each SVG that was rendered again, instead of loaded from the cache
+	typedef QPair<QString, int> RenderTime;
+	foreach (const RenderTime& time, m_theme->renderTimes()) {
+		m_instrumentation.record(Instrumentation::ThemeElement, qint64(time.second) * 1000, time.first);
+	}
+}
+
+// ============================================================================
@@ -20,13 +20,20 @@
 #ifndef BOARD_H
 #define BOARD_H
 
+#include <QPixmap>
 #include <QTime>
 #include <QWidget>
+#include "corridors.h"
+#include "instrumentation.h"
+#include "journal.h"
+#include "overview.h"
+#include "replay.h"
+#include "solver.h"
 #include "AQCode.h" // ADDED BY LARS PETTER MOSTAD
 class QLabel;
 class QMainWindow;
-class QTimeLine;
 class QTimer;
+class Generator;
 class Maze;
 class Theme;
 
@@ -37,16 +44,21 @@ public:
 	Board(QMainWindow* parent);
 	~Board();
 
+	bool playReplay(const QString& filename);
+
 signals:
 	void pauseChecked(bool checked);
 	void pauseAvailable(bool run);
-	void finished(int seconds, int steps, int algorithm, int size);
+	void finished(int steps, int seconds, int algorithm, int columns, int rows, int optimal);
 
 public slots:
 	void newGame();
 	void loadGame();
 	void saveGame();
 	void pauseGame(bool paused);
+	void showOverview(bool show);
+	void showRoute(bool show);
+	void showStatistics(bool show);
 	void loadSettings();
 
 protected:
@@ -54,32 +66,60 @@ protected:
 	virtual void mousePressEvent(QMouseEvent* event); // ADDED BY TERJE GUNDERSEN
 	virtual void mouseReleaseEvent(QMouseEvent* event); // ADDED BY TERJE GUNDERSEN
 	virtual void keyReleaseEvent(QKeyEvent* event); // ADDED BY LARS PETTER MOSTAD
-	virtual void paintEvent(QPaintEvent*);
+	virtual void paintEvent(QPaintEvent* event);
 	virtual void resizeEvent(QResizeEvent*);
 
 private slots:
 	void focusChanged();
 	void updateStatusMessage();
+	void tick();
 	void move(); // ADDED BY LARS PETTER MOSTAD
+	void generated();
 
 private:
 	void generate(unsigned int seed);
+	void pregenerate();
+	void cancelGeneration();
+	void startGame();
+	void resumeGame();
 	void finish();
-	void renderMaze(int frame);
+	void toggleFlag();
+	void updateRoute();
+	void recordInput(Replay::EventType type, int value);
+	bool replayInputs();
+	void advanceClock();
+	void scheduleTick();
+	void setMoveClock(bool run);
+	void setStatusClock(bool run);
+	qreal animationProgress() const;
+	void updateCell(const QPoint& cell);
+	void renderLayer();
+	void renderMaze(qreal progress, const QRect& area);
 	void renderDone();
+	void renderOverview(const QString& message = QString());
+	void renderStatistics();
 	void renderPause();
+	void renderGenerating();
 	void renderText(QPainter* painter, const QString& message) const;
+	void recordTheme(qint64 start, const QString& details);
 
 	bool m_done;
 	bool m_paused;
+	bool m_generating;
+	bool m_loading;
 	
 	int m_total_targets;
 	Maze* m_maze;
+	Journal m_journal;
+	CorridorGraph m_corridors;
+	Solver m_solver;
 	QPoint m_start;
 	QList<QPoint> m_targets;
+	int m_optimal_steps;
 	QLabel* m_status_message;
-	QTimer* m_status_timer;
-	QTimer* m_move_timer; // ADDED BY LARS PETTER MOSTAD
+	Generator* m_generator;
+	Generator* m_next_generator;
+	QTimer* m_generate_timer;
 
 	bool m_show_path;
 	bool m_show_time;
@@ -88,15 +128,44 @@ private:
 	bool m_smooth_movement;
 	int m_col_delta;
 	int m_row_delta;
-	QTimeLine* m_move_animation;
+
+	// Frame clock
+	QTimer* m_frame_timer;
+	QTime m_frame_clock;
+	int m_animation_time;
+	int m_animation_duration;
+	bool m_move_clock;
+	int m_move_time;
+	bool m_status_clock;
+	int m_status_time;
+
+	// Replays
+	Replay m_replay;
+	QString m_record_file;
+	bool m_recording;
+	bool m_replaying;
+	int m_replay_event;
+	int m_moves;
 
 	Theme* m_theme;
 	int m_unit;
+	QPixmap m_layer;
+	QPoint m_layer_origin;
+	Overview m_overview;
+	bool m_show_overview;
+	bool m_show_route;
+	QList<QPoint> m_route;
+
+	Instrumentation m_instrumentation;
+	bool m_show_statistics;
+	qint64 m_input_time;
+	bool m_input_shown;
 
 	// Player
 	QPoint m_player;
 	int m_player_direction;	 // ADDED BY LARS PETTER MOSTAD
 	bool m_player_firststep; // ADDED BY LARS PETTER MOSTAD
+	CorridorGraph::Run m_player_run;
 	int m_player_angle;
 	int m_player_steps;
 	QTime m_player_time;
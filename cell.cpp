@@ -24,12 +24,7 @@
 // ============================================================================
 
 Cell::Cell()
-:	m_left_wall(true),
-	m_right_wall(true),
-	m_top_wall(true),
-	m_bottom_wall(true),
-	m_flag(false),
-	m_path_marker(0)
+:	m_data(Walls)
 {
 }
 
@@ -38,21 +33,12 @@ Cell::Cell()
 // <s> ADDED BY LARS PETTER MOSTAD
 bool Cell::isFork() const
 {
-	int numOpens = 0;
-	
-	if(!m_top_wall)
-		numOpens++;
-	if(!m_bottom_wall)
-		numOpens++;
-	if(!m_left_wall)
-		numOpens++;
-	if(!m_right_wall)
-		numOpens++;
-	
-	if(numOpens > 2)
-		return true;
-	else
-		return false;
+	// Lookup of open sides for each wall nibble
+	static const unsigned char openings[16] = {
+		4, 3, 3, 2, 3, 2, 2, 1, 3, 2, 2, 1, 2, 1, 1, 0
+	};
+
+	return openings[m_data & Walls] > 2;
 }
 // </s>
 
@@ -61,19 +47,27 @@ bool Cell::isFork() const
 void Cell::setPathMarker(int angle)
 {
 	Q_ASSERT(angle == 90 || angle == 180 || angle == 270 || angle == 360);
-	m_path_marker = angle / 90;
+	m_data = (m_data & ~PathMarker) | ((angle / 90) << PathMarkerShift);
 }
 
 // ============================================================================
 
 QDataStream& operator<<(QDataStream& stream, const Cell& cell)
 {
-	return stream << cell.m_path_marker << cell.m_flag;
+	unsigned char path_marker = cell.m_data >> Cell::PathMarkerShift;
+	bool flag = cell.m_data & Cell::Flag;
+	return stream << path_marker << flag;
 }
 
 QDataStream& operator>>(QDataStream& stream, Cell& cell)
 {
-	return stream >> cell.m_path_marker >> cell.m_flag;
+	unsigned char path_marker;
+	bool flag;
+	stream >> path_marker >> flag;
+	if (stream.status() == QDataStream::Ok && path_marker < 5) {
+		cell.m_data = (cell.m_data & Cell::Walls) | (path_marker << Cell::PathMarkerShift) | (flag ? Cell::Flag : 0);
+	}
+	return stream;
 }
 
 // ============================================================================
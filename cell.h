@@ -28,42 +28,48 @@ public:
 	Cell();
 
 	bool leftWall() const
-		{ return m_left_wall; }
+		{ return m_data & LeftWall; }
 	bool rightWall() const
-		{ return m_right_wall; }
+		{ return m_data & RightWall; }
 	bool topWall() const
-		{ return m_top_wall; }
+		{ return m_data & TopWall; }
 	bool bottomWall() const
-		{ return m_bottom_wall; }
+		{ return m_data & BottomWall; }
 	bool isFork() const; // ADDED BY LARS PETTER MOSTAD
 	void removeLeftWall()
-		{ m_left_wall = false; }
+		{ m_data &= ~LeftWall; }
 	void removeRightWall()
-		{ m_right_wall = false; }
+		{ m_data &= ~RightWall; }
 	void removeTopWall()
-		{ m_top_wall = false; }
+		{ m_data &= ~TopWall; }
 	void removeBottomWall()
-		{ m_bottom_wall = false; }
+		{ m_data &= ~BottomWall; }
 
 	int pathMarker() const
-		{ return m_path_marker * 90; }
+		{ return (m_data >> PathMarkerShift) * 90; }
 	void setPathMarker(int angle);
 
 	bool flag() const
-		{ return m_flag; }
+		{ return m_data & Flag; }
 	void toggleFlag()
-		{ m_flag = !m_flag; }
+		{ m_data ^= Flag; }
 
     friend QDataStream& operator<<(QDataStream&, const Cell&);
     friend QDataStream& operator>>(QDataStream&, Cell&);
 
 private:
-	bool m_left_wall;
-	bool m_right_wall;
-	bool m_top_wall;
-	bool m_bottom_wall;
-	bool m_flag;
-	unsigned char m_path_marker;
+	// Walls take the low nibble, followed by the flag and the path marker
+	enum {
+		LeftWall = 0x01,
+		RightWall = 0x02,
+		TopWall = 0x04,
+		BottomWall = 0x08,
+		Walls = 0x0f,
+		Flag = 0x10,
+		PathMarkerShift = 5,
+		PathMarker = 0xe0
+	};
+	unsigned char m_data;
 };
 
 #endif // CELL_H
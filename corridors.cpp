@@ -0,0 +1,326 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "corridors.h"
+
+#include "maze.h"
+
+namespace {
+// ============================================================================
+
+bool isOpen(const Cell& cell, int direction)
+{
+	switch (direction) {
+	case 1:
+		return !cell.rightWall();
+	case 2:
+		return !cell.topWall();
+	case 3:
+		return !cell.leftWall();
+	default:
+		return !cell.bottomWall();
+	}
+}
+
+// ============================================================================
+
+int opposite(int direction)
+{
+	return ((direction + 1) % 4) + 1;
+}
+
+// ============================================================================
+
+// Cells with other than two ways out are junctions
+bool isJunction(const Maze* maze, int index)
+{
+	const Cell& cell = maze->cell(index % maze->columns(), index / maze->columns());
+	return (!cell.leftWall() + !cell.rightWall() + !cell.topWall() + !cell.bottomWall()) != 2;
+}
+
+// ============================================================================
+
+// Returns the way out of a corridor cell that was not used to come in
+int leave(const Maze* maze, int index, int way)
+{
+	const Cell& cell = maze->cell(index % maze->columns(), index / maze->columns());
+	int back = opposite(way);
+	for (way = 1; way == back || !isOpen(cell, way); ++way) {
+	}
+	return way;
+}
+
+// ============================================================================
+
+int bitCount(quint64 bits)
+{
+	bits = bits - ((bits >> 1) & Q_UINT64_C(0x5555555555555555));
+	bits = (bits & Q_UINT64_C(0x3333333333333333)) + ((bits >> 2) & Q_UINT64_C(0x3333333333333333));
+	bits = (bits + (bits >> 4)) & Q_UINT64_C(0x0f0f0f0f0f0f0f0f);
+	return int((bits * Q_UINT64_C(0x0101010101010101)) >> 56);
+}
+
+// ============================================================================
+}
+
+// ============================================================================
+
+CorridorGraph::CorridorGraph()
+:	m_columns(0),
+	m_junctions(0),
+	m_corridor_count(0),
+	m_step_count(0)
+{
+}
+
+// ============================================================================
+
+void CorridorGraph::build(const Maze* maze)
+{
+	clear();
+	m_columns = maze->columns();
+	int count = m_columns * maze->rows();
+	const int offsets[5] = { 0, 1, -m_columns, -1, m_columns };
+	m_ways = QVector<quint64>((count * 4 + 63) / 64, 0);
+
+	// Walk each corridor from both of its junctions, and keep it from the
+	// lower one if it passes any cells on the way; mark the ways into it
+	// from both ends
+	QVector<int> ends;
+	for (int start = 0; start < count; ++start) {
+		if (!isJunction(maze, start)) {
+			continue;
+		}
+		m_junctions++;
+		const Cell& junction = maze->cell(start % m_columns, start / m_columns);
+		for (int direction = 1; direction < 5; ++direction) {
+			if (!isOpen(junction, direction)) {
+				continue;
+			}
+			int length = 1;
+			int way = direction;
+			int next = start + offsets[way];
+			for (; !isJunction(maze, next); ++length) {
+				way = leave(maze, next, way);
+				next += offsets[way];
+			}
+			if (next < start) {
+				continue;
+			}
+			m_corridor_count++;
+			if (length == 1) {
+				continue;
+			}
+
+			int start_way = start * 4 + direction - 1;
+			int end_way = next * 4 + opposite(way) - 1;
+			m_ways[start_way / 64] |= Q_UINT64_C(1) << (start_way % 64);
+			m_ways[end_way / 64] |= Q_UINT64_C(1) << (end_way % 64);
+			ends << start_way << end_way;
+
+			m_offsets.append(m_step_count);
+			way = direction;
+			next = start + offsets[way];
+			appendStep(way);
+			for (int i = 1; i < length; ++i) {
+				way = leave(maze, next, way);
+				next += offsets[way];
+				appendStep(way);
+			}
+		}
+	}
+
+	// Number the marked ways, and point each at its corridor
+	m_way_ranks.resize(m_ways.size());
+	int rank = 0;
+	for (int i = 0; i < m_ways.size(); ++i) {
+		m_way_ranks[i] = rank;
+		rank += bitCount(m_ways.at(i));
+	}
+	m_entries.resize(rank);
+	for (int corridor = 0; corridor < m_offsets.size(); ++corridor) {
+		int start_way = ends.at(corridor * 2);
+		int end_way = ends.at(corridor * 2 + 1);
+		m_entries[entry(start_way / 4, start_way % 4 + 1)] = corridor * 2;
+		m_entries[entry(end_way / 4, end_way % 4 + 1)] = corridor * 2 + 1;
+	}
+}
+
+// ============================================================================
+
+void CorridorGraph::clear()
+{
+	m_junctions = 0;
+	m_corridor_count = 0;
+	m_offsets.clear();
+	m_steps.clear();
+	m_step_count = 0;
+	m_ways.clear();
+	m_way_ranks.clear();
+	m_entries.clear();
+}
+
+// ============================================================================
+
+CorridorGraph::Run CorridorGraph::locate(const Maze* maze, const QPoint& cell) const
+{
+	// Only needed where the player appears inside a corridor without having
+	// walked there; finds the junction behind, and faces away from it
+	Run run;
+	int index = cell.y() * m_columns + cell.x();
+	if (isJunction(maze, index)) {
+		return run;
+	}
+	const int offsets[5] = { 0, 1, -m_columns, -1, m_columns };
+	const Cell& here = maze->cell(cell.x(), cell.y());
+	int way = 1;
+	while (!isOpen(here, way)) {
+		++way;
+	}
+	int position = 1;
+	int behind = index + offsets[way];
+	for (; !isJunction(maze, behind); ++position) {
+		way = leave(maze, behind, way);
+		behind += offsets[way];
+	}
+
+	int found = entry(behind, opposite(way));
+	if (found == -1) {
+		return run;
+	}
+	int value = m_entries.at(found);
+	run.corridor = value / 2;
+	if (value & 1) {
+		run.reverse = true;
+		run.remaining = length(run.corridor) - position;
+		run.step = run.remaining - 1;
+	} else {
+		run.step = position;
+		run.remaining = length(run.corridor) - position;
+	}
+	return run;
+}
+
+// ============================================================================
+
+CorridorGraph::Run CorridorGraph::follow(const Run& run, const QPoint& cell, int direction) const
+{
+	Run next = run;
+	if (next.corridor == -1 || next.remaining == 0) {
+		// Leaving a junction starts on the corridor that way, if it has one
+		int found = entry(cell.y() * m_columns + cell.x(), direction);
+		if (found == -1) {
+			return Run();
+		}
+		int value = m_entries.at(found);
+		next.corridor = value / 2;
+		next.reverse = value & 1;
+		next.remaining = length(next.corridor);
+		next.step = next.reverse ? next.remaining - 1 : 0;
+	} else if (heading(next) != direction) {
+		// Turning back walks the other way from the same place
+		int position = next.reverse ? next.remaining : next.step;
+		next.reverse = !next.reverse;
+		next.step = next.reverse ? position - 1 : position;
+		next.remaining = next.reverse ? position : length(next.corridor) - position;
+	}
+
+	QPoint moved = cell;
+	advance(next, moved);
+	return next;
+}
+
+// ============================================================================
+
+int CorridorGraph::heading(const Run& run) const
+{
+	if (run.remaining == 0) {
+		return 0;
+	}
+	int direction = step(run.corridor, run.step);
+	return run.reverse ? opposite(direction) : direction;
+}
+
+// ============================================================================
+
+int CorridorGraph::advance(Run& run, QPoint& cell) const
+{
+	Q_ASSERT(run.remaining > 0);
+	int direction = heading(run);
+	switch (direction) {
+	case 1:
+		cell.rx()++;
+		break;
+	case 2:
+		cell.ry()--;
+		break;
+	case 3:
+		cell.rx()--;
+		break;
+	default:
+		cell.ry()++;
+		break;
+	}
+	run.step += run.reverse ? -1 : 1;
+	run.remaining--;
+	return direction;
+}
+
+// ============================================================================
+
+int CorridorGraph::length(int corridor) const
+{
+	int end = (corridor + 1 < m_offsets.size()) ? m_offsets.at(corridor + 1) : m_step_count;
+	return end - m_offsets.at(corridor);
+}
+
+// ============================================================================
+
+int CorridorGraph::step(int corridor, int index) const
+{
+	index += m_offsets.at(corridor);
+	return ((m_steps.at(index / 4) >> ((index % 4) * 2)) & 0x3) + 1;
+}
+
+// ============================================================================
+
+int CorridorGraph::entry(int cell, int direction) const
+{
+	// Ways marked before this one number it among the entries
+	int way = cell * 4 + direction - 1;
+	quint64 word = m_ways.at(way / 64);
+	quint64 bit = Q_UINT64_C(1) << (way % 64);
+	if (!(word & bit)) {
+		return -1;
+	}
+	return m_way_ranks.at(way / 64) + bitCount(word & (bit - 1));
+}
+
+// ============================================================================
+
+void CorridorGraph::appendStep(int direction)
+{
+	if (m_step_count % 4 == 0) {
+		m_steps.append(char(0));
+	}
+	m_steps[m_step_count / 4] = m_steps.at(m_step_count / 4) | ((direction - 1) << ((m_step_count % 4) * 2));
+	m_step_count++;
+}
+
+// ============================================================================
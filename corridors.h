@@ -0,0 +1,81 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef CORRIDORS_H
+#define CORRIDORS_H
+
+#include <QByteArray>
+#include <QPoint>
+#include <QVector>
+class Maze;
+
+// Corridors of a maze between its junctions, which are the forks and dead
+// ends; each corridor that passes other cells keeps its steps so that it can
+// be walked without looking at walls (directions are 1 right, 2 up, 3 left,
+// 4 down). Both junctions of a corridor find it in constant time through a
+// ranked bit for each way out of each cell
+class CorridorGraph
+{
+public:
+	// Place of the player in a corridor, walking towards one of its junctions;
+	// the player is at a junction once nothing remains
+	struct Run
+	{
+		Run()
+			: corridor(-1), step(0), remaining(0), reverse(false) { }
+
+		int corridor;
+		int step;
+		int remaining;
+		bool reverse;
+	};
+
+	CorridorGraph();
+
+	void build(const Maze* maze);
+	void clear();
+
+	int junctions() const
+		{ return m_junctions; }
+	int corridors() const
+		{ return m_corridor_count; }
+
+	Run locate(const Maze* maze, const QPoint& cell) const;
+	Run follow(const Run& run, const QPoint& cell, int direction) const;
+	int heading(const Run& run) const;
+	int advance(Run& run, QPoint& cell) const;
+
+private:
+	int length(int corridor) const;
+	int step(int corridor, int index) const;
+	int entry(int cell, int direction) const;
+	void appendStep(int direction);
+
+	int m_columns;
+	int m_junctions;
+	int m_corridor_count;
+	QVector<int> m_offsets; // first step of each corridor
+	QByteArray m_steps; // four steps per byte
+	int m_step_count;
+	QVector<quint64> m_ways; // set where a corridor leaves a junction
+	QVector<int> m_way_ranks; // ways set before each word
+	QVector<int> m_entries; // corridor of each way set, doubled, plus one if reversed
+};
+
+#endif // CORRIDORS_H
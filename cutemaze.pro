@@ -13,19 +13,35 @@ HEADERS += AQCode.h \
            ATKCode.h \
            board.h \
            cell.h \
+           corridors.h \
+           generator.h \
+           instrumentation.h \
+           journal.h \
            maze.h \
+           movement.h \
+           overview.h \
+           replay.h \
            scores.h \
            settings.h \
+           solver.h \
            theme.h \
            window.h
 SOURCES += AQCode.cpp \
            ATKCode.cpp \
            board.cpp \
            cell.cpp \
+           corridors.cpp \
+           generator.cpp \
+           instrumentation.cpp \
+           journal.cpp \
            main.cpp \
            maze.cpp \
+           movement.cpp \
+           overview.cpp \
+           replay.cpp \
            scores.cpp \
            settings.cpp \
+           solver.cpp \
            theme.cpp \
            window.cpp
 
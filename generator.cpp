@@ -0,0 +1,257 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "generator.h"
+
+#include "maze.h"
+
+#include <QBitArray>
+#include <QVector>
+
+#include <cstdlib>
+
+// ============================================================================
+
+namespace
+{
+
+// Counts free cells so that the nth free cell can be found in logarithmic time
+class FreeCells
+{
+public:
+	FreeCells(int size);
+
+	void take(int index);
+	int find(int n) const;
+
+private:
+	QVector<int> m_tree;
+	int m_mask;
+};
+
+// ============================================================================
+
+FreeCells::FreeCells(int size)
+:	m_tree(size + 1, 0),
+	m_mask(1)
+{
+	// Build the tree of counts in linear time
+	for (int i = 1; i <= size; ++i) {
+		m_tree[i] += 1;
+		int parent = i + (i & -i);
+		if (parent <= size) {
+			m_tree[parent] += m_tree[i];
+		}
+	}
+	while ((m_mask << 1) <= size) {
+		m_mask <<= 1;
+	}
+}
+
+// ============================================================================
+
+void FreeCells::take(int index)
+{
+	for (int i = index + 1; i < m_tree.size(); i += (i & -i)) {
+		m_tree[i] -= 1;
+	}
+}
+
+// ============================================================================
+
+int FreeCells::find(int n) const
+{
+	int index = 0;
+	for (int mask = m_mask; mask; mask >>= 1) {
+		int next = index + mask;
+		if (next < m_tree.size() && m_tree[next] <= n) {
+			index = next;
+			n -= m_tree[next];
+		}
+	}
+	return index;
+}
+
+}
+
+// ============================================================================
+
+Generator::Generator(QObject* parent)
+:	QThread(parent),
+	m_seed(0),
+	m_algorithm(0),
+	m_columns(0),
+	m_rows(0),
+	m_total_targets(0),
+	m_maze(0),
+	m_optimal_steps(-1),
+	m_ready(0)
+{
+}
+
+// ============================================================================
+
+Generator::~Generator()
+{
+	cancel();
+	wait();
+	delete m_maze;
+}
+
+// ============================================================================
+
+void Generator::generate(unsigned int seed, int algorithm, int columns, int rows, int targets)
+{
+	// Stop previous maze
+	cancel();
+	wait();
+	delete m_maze;
+	m_ready = 0;
+
+	m_seed = seed;
+	m_algorithm = algorithm;
+	m_columns = columns;
+	m_rows = rows;
+	m_total_targets = targets;
+	m_targets.clear();
+	m_optimal_steps = -1;
+	m_corridors.clear();
+	m_solver.clear();
+
+	// Create the maze here so that it can be canceled before the thread runs
+	m_maze = Maze::create(algorithm);
+	start();
+}
+
+// ============================================================================
+
+void Generator::cancel()
+{
+	if (m_maze) {
+		m_maze->cancel();
+	}
+}
+
+// ============================================================================
+
+bool Generator::isCanceled() const
+{
+	return m_maze && m_maze->isCanceled();
+}
+
+// ============================================================================
+
+int Generator::progress() const
+{
+	return m_maze ? m_maze->progress() : 0;
+}
+
+// ============================================================================
+
+bool Generator::isPending() const
+{
+	return m_maze && !m_maze->isCanceled();
+}
+
+// ============================================================================
+
+bool Generator::matches(int algorithm, int columns, int rows, int targets) const
+{
+	return isPending() && (algorithm == m_algorithm) && (columns == m_columns) && (rows == m_rows) && (targets == m_total_targets);
+}
+
+// ============================================================================
+
+Maze* Generator::takeMaze()
+{
+	Q_ASSERT(isReady());
+	m_ready = 0;
+	Maze* maze = m_maze;
+	m_maze = 0;
+	return maze;
+}
+
+// ============================================================================
+
+void Generator::run()
+{
+	// Seed in this thread, as some platforms keep a random state per thread
+	srand(m_seed);
+	m_maze->generate(m_columns, m_rows);
+	if (m_maze->isCanceled()) {
+		return;
+	}
+	m_corridors.build(m_maze);
+
+	// Add player
+	m_start.setX(rand() % (m_columns - 1));
+	m_start.setY(rand() % (m_rows - 1));
+
+	// Add targets
+	if (m_columns * m_rows > m_total_targets * 2) {
+		placeSparseTargets();
+	// Handle if targets cover half or more of the maze
+	} else {
+		placeDenseTargets();
+	}
+
+	// Keep the way from every cell to the start, and find the shortest walk
+	// collecting every target to score against
+	m_solver.build(m_maze, m_start);
+	m_solver.route(m_start, m_targets, &m_optimal_steps);
+	m_maze->updatePeakMemory();
+
+	m_ready = 1;
+}
+
+// ============================================================================
+
+void Generator::placeSparseTargets()
+{
+	// Draw random cells until a free one is found, like the list lookup did
+	QBitArray used(m_columns * m_rows);
+	used.setBit(m_start.x() * m_rows + m_start.y());
+	QPoint target;
+	for (int i = 0; i < m_total_targets; ++i) {
+		do {
+			target.setX(rand() % (m_columns - 1));
+			target.setY(rand() % (m_rows - 1));
+		} while (used.testBit(target.x() * m_rows + target.y()));
+		used.setBit(target.x() * m_rows + target.y());
+		m_targets.append(target);
+	}
+}
+
+// ============================================================================
+
+void Generator::placeDenseTargets()
+{
+	// Pick from the remaining cells in column order, like the list lookup did
+	FreeCells cells(m_columns * m_rows);
+	cells.take(m_start.x() * m_rows + m_start.y());
+	int remaining = m_columns * m_rows - 1;
+	for (int i = 0; i < m_total_targets; ++i) {
+		int index = cells.find(randomIndex(remaining));
+		cells.take(index);
+		--remaining;
+		m_targets.append(QPoint(index / m_rows, index % m_rows));
+	}
+}
+
+// ============================================================================
@@ -0,0 +1,86 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <QAtomicInt>
+#include <QList>
+#include <QPoint>
+#include <QThread>
+#include "corridors.h"
+#include "solver.h"
+class Maze;
+
+// Builds a maze and places the player and targets on a worker thread
+class Generator : public QThread
+{
+public:
+	enum { MaximumTargets = 10000 };
+
+	Generator(QObject* parent = 0);
+	~Generator();
+
+	void generate(unsigned int seed, int algorithm, int columns, int rows, int targets);
+	void cancel();
+	bool isCanceled() const;
+	bool isReady() const
+		{ return m_ready != 0; }
+	int progress() const;
+
+	bool isPending() const;
+	bool matches(int algorithm, int columns, int rows, int targets) const;
+	unsigned int seed() const
+		{ return m_seed; }
+
+	Maze* takeMaze();
+	QPoint startLocation() const
+		{ return m_start; }
+	QList<QPoint> targets() const
+		{ return m_targets; }
+	int optimalSteps() const
+		{ return m_optimal_steps; }
+	const CorridorGraph& corridors() const
+		{ return m_corridors; }
+	const Solver& solver() const
+		{ return m_solver; }
+
+protected:
+	virtual void run();
+
+private:
+	void placeSparseTargets();
+	void placeDenseTargets();
+
+	unsigned int m_seed;
+	int m_algorithm;
+	int m_columns;
+	int m_rows;
+	int m_total_targets;
+
+	Maze* m_maze;
+	QPoint m_start;
+	QList<QPoint> m_targets;
+	int m_optimal_steps;
+	CorridorGraph m_corridors;
+	Solver m_solver;
+	QAtomicInt m_ready;
+};
+
+#endif // GENERATOR_H
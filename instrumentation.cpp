@@ -0,0 +1,177 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "instrumentation.h"
+
+#include <cstdlib>
+
+// ============================================================================
+
+namespace
+{
+
+const char* const event_names[Instrumentation::TotalEvents] = {
+	"frame",
+	"latency",
+	"generation",
+	"voice",
+	"theme",
+	"theme element"
+};
+
+const char* const wakeup_names[Instrumentation::TotalWakeups] = {
+	"timer",
+	"paint"
+};
+
+}
+
+// ============================================================================
+
+Instrumentation::Instrumentation()
+:	m_wakeup_second(0),
+	m_pregenerated_hits(0),
+	m_pregenerated_misses(0)
+{
+	for (int i = 0; i < TotalEvents; ++i) {
+		Statistics& statistics = m_statistics[i];
+		statistics.count = 0;
+		statistics.last = 0;
+		statistics.total = 0;
+		statistics.worst = 0;
+	}
+	for (int i = 0; i < TotalWakeups; ++i) {
+		m_wakeups[i] = 0;
+		m_previous_wakeups[i] = 0;
+	}
+	m_clock.start();
+
+	// Write trace when asked for
+	QString filename = getenv("CUTEMAZE_TRACE");
+	if (!filename.isEmpty()) {
+		m_trace_file.setFileName(filename);
+		if (m_trace_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+			m_trace.setDevice(&m_trace_file);
+			m_trace << "time,event,microseconds,details\n";
+		} else {
+			qWarning("Unable to write trace file %s", qPrintable(filename));
+		}
+	}
+}
+
+// ============================================================================
+
+qint64 Instrumentation::now() const
+{
+#if QT_VERSION >= 0x040800
+	return m_clock.nsecsElapsed() / 1000;
+#else
+	return qint64(m_clock.elapsed()) * 1000;
+#endif
+}
+
+// ============================================================================
+
+void Instrumentation::record(Event event, qint64 usecs, const QString& details)
+{
+	Q_ASSERT(event != TotalEvents);
+	Statistics& statistics = m_statistics[event];
+	statistics.count++;
+	statistics.last = usecs;
+	statistics.total += usecs;
+	statistics.worst = qMax(statistics.worst, usecs);
+
+	if (m_trace.device()) {
+		m_trace << now() << ',' << event_names[event] << ',' << usecs << ',' << details << '\n';
+	}
+}
+
+// ============================================================================
+
+void Instrumentation::wakeup(Wakeup wakeup)
+{
+	Q_ASSERT(wakeup != TotalWakeups);
+
+	// Start counting a new second
+	qint64 second = now() / 1000000;
+	if (second != m_wakeup_second) {
+		for (int i = 0; i < TotalWakeups; ++i) {
+			m_previous_wakeups[i] = (second == m_wakeup_second + 1) ? m_wakeups[i] : 0;
+			m_wakeups[i] = 0;
+		}
+		m_wakeup_second = second;
+	}
+	m_wakeups[wakeup]++;
+}
+
+// ============================================================================
+
+void Instrumentation::pregenerated(bool hit)
+{
+	if (hit) {
+		m_pregenerated_hits++;
+	} else {
+		m_pregenerated_misses++;
+	}
+
+	if (m_trace.device()) {
+		m_trace << now() << ",pregenerated,0," << (hit ? "hit" : "miss") << '\n';
+	}
+}
+
+// ============================================================================
+
+QStringList Instrumentation::summary() const
+{
+	QStringList lines;
+	for (int i = 0; i < TotalEvents; ++i) {
+		const Statistics& statistics = m_statistics[i];
+		if (statistics.count == 0) {
+			lines.append(QString("%1: -").arg(event_names[i]));
+		} else {
+			lines.append(QString("%1: %2 ms last, %3 ms average, %4 ms worst, %5 samples")
+				.arg(event_names[i])
+				.arg(statistics.last / 1000.0, 0, 'f', 1)
+				.arg(statistics.total / 1000.0 / statistics.count, 0, 'f', 1)
+				.arg(statistics.worst / 1000.0, 0, 'f', 1)
+				.arg(statistics.count));
+		}
+	}
+
+	// Find wakeups of the last full second; none were counted if it is stale
+	qint64 second = now() / 1000000;
+	const int* wakeups = 0;
+	if (second == m_wakeup_second) {
+		wakeups = m_previous_wakeups;
+	} else if (second == m_wakeup_second + 1) {
+		wakeups = m_wakeups;
+	}
+	QStringList counts;
+	int total = 0;
+	for (int i = 0; i < TotalWakeups; ++i) {
+		int count = wakeups ? wakeups[i] : 0;
+		counts.append(QString("%1 %2").arg(count).arg(wakeup_names[i]));
+		total += count;
+	}
+	lines.append(QString("wakeups: %1 per second (%2)").arg(total).arg(counts.join(", ")));
+	lines.append(QString("pregenerated: %1 hits, %2 misses").arg(m_pregenerated_hits).arg(m_pregenerated_misses));
+	return lines;
+}
+
+// ============================================================================
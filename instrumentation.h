@@ -0,0 +1,89 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QtGlobal>
+#if QT_VERSION >= 0x040800
+#include <QElapsedTimer>
+#else
+#include <QTime>
+#endif
+
+// Keeps statistics of how long things take, and optionally writes each one to a trace file
+class Instrumentation
+{
+public:
+	enum Event {
+		Frame,
+		Latency,
+		Generation,
+		Voice,
+		ThemeScale,
+		ThemeElement,
+		TotalEvents
+	};
+
+	enum Wakeup {
+		TimerWakeup,
+		PaintWakeup,
+		TotalWakeups
+	};
+
+	Instrumentation();
+
+	qint64 now() const;
+	void record(Event event, qint64 usecs, const QString& details = QString());
+	void wakeup(Wakeup wakeup);
+	void pregenerated(bool hit);
+	QStringList summary() const;
+
+private:
+	struct Statistics
+	{
+		int count;
+		qint64 last;
+		qint64 total;
+		qint64 worst;
+	};
+	Statistics m_statistics[TotalEvents];
+
+	// Wakeups counted in the current second and in the one before it
+	qint64 m_wakeup_second;
+	int m_wakeups[TotalWakeups];
+	int m_previous_wakeups[TotalWakeups];
+
+	// New games that did or did not find their maze already built
+	int m_pregenerated_hits;
+	int m_pregenerated_misses;
+
+#if QT_VERSION >= 0x040800
+	QElapsedTimer m_clock;
+#else
+	QTime m_clock;
+#endif
+	QFile m_trace_file;
+	QTextStream m_trace;
+};
+
+#endif // INSTRUMENTATION_H
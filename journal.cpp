@@ -0,0 +1,176 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "journal.h"
+
+#include "maze.h"
+
+#include <QPoint>
+
+#if defined(Q_OS_UNIX)
+#include <unistd.h>
+#endif
+
+// ============================================================================
+
+namespace
+{
+
+// Each entry is a type, a column and row, a path marker and rotation divided
+// by 90, and the milliseconds played so far
+enum EntryType {
+	MoveEntry = 1,
+	FlagEntry = 2
+};
+const int entry_size = 11;
+
+}
+
+// ============================================================================
+
+Journal::Journal()
+:	m_size(0)
+{
+}
+
+// ============================================================================
+
+void Journal::reset(const QString& filename)
+{
+	m_file.close();
+	m_file.setFileName(filename);
+	m_size = 0;
+	if (filename.isEmpty()) {
+		return;
+	}
+	if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered)) {
+		qWarning("Unable to write journal %s", qPrintable(filename));
+	}
+}
+
+// ============================================================================
+
+void Journal::open(const QString& filename, int entries)
+{
+	// Keep the entries already replayed, dropping anything written after them
+	m_file.close();
+	m_file.setFileName(filename);
+	m_size = 0;
+	if (filename.isEmpty()) {
+		return;
+	}
+	if (!m_file.open(QIODevice::ReadWrite | QIODevice::Unbuffered) || !m_file.resize(qint64(entries) * entry_size) || !m_file.seek(m_file.size())) {
+		qWarning("Unable to write journal %s", qPrintable(filename));
+		m_file.close();
+		return;
+	}
+	m_size = entries;
+}
+
+// ============================================================================
+
+void Journal::discard()
+{
+	m_file.close();
+	if (!m_file.fileName().isEmpty()) {
+		m_file.remove();
+	}
+	m_size = 0;
+}
+
+// ============================================================================
+
+void Journal::recordMove(const QPoint& player, int marker, int rotation, int msecs)
+{
+	write(MoveEntry, player, marker / 90, rotation / 90, msecs);
+}
+
+// ============================================================================
+
+void Journal::recordFlag(const QPoint& cell, int msecs)
+{
+	write(FlagEntry, cell, 0, 0, msecs);
+}
+
+// ============================================================================
+
+int Journal::replay(const QString& filename, Maze* maze, QPoint& player, int& rotation, int& steps, int& msecs) const
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return 0;
+	}
+	QByteArray data = file.readAll();
+
+	// Apply entries in order, stopping at a damaged or partly written one
+	int count = 0;
+	for (int pos = 0; pos + entry_size <= data.size(); pos += entry_size) {
+		const uchar* entry = reinterpret_cast<const uchar*>(data.constData() + pos);
+		int type = entry[0];
+		QPoint cell((entry[1] << 8) | entry[2], (entry[3] << 8) | entry[4]);
+		int marker = entry[5];
+		int angle = entry[6];
+		if (cell.x() >= maze->columns() || cell.y() >= maze->rows() || marker > 4) {
+			break;
+		}
+
+		if (type == MoveEntry && angle > 0 && angle <= 4) {
+			if (marker) {
+				maze->cellMutable(player.x(), player.y()).setPathMarker(marker * 90);
+			}
+			player = cell;
+			rotation = angle * 90;
+			steps++;
+		} else if (type == FlagEntry) {
+			maze->cellMutable(cell.x(), cell.y()).toggleFlag();
+		} else {
+			break;
+		}
+		msecs = (entry[7] << 24) | (entry[8] << 16) | (entry[9] << 8) | entry[10];
+		count++;
+	}
+	return count;
+}
+
+// ============================================================================
+
+void Journal::write(int type, const QPoint& cell, int marker, int rotation, int msecs)
+{
+	if (!m_file.isOpen()) {
+		return;
+	}
+
+	uchar entry[entry_size] = {
+		uchar(type),
+		uchar(cell.x() >> 8), uchar(cell.x()),
+		uchar(cell.y() >> 8), uchar(cell.y()),
+		uchar(marker),
+		uchar(rotation),
+		uchar(msecs >> 24), uchar(msecs >> 16), uchar(msecs >> 8), uchar(msecs)
+	};
+	m_file.write(reinterpret_cast<const char*>(entry), entry_size);
+
+	// Make sure the entry survives losing power
+#if defined(Q_OS_UNIX)
+	fsync(m_file.handle());
+#endif
+	m_size++;
+}
+
+// ============================================================================
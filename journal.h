@@ -0,0 +1,50 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <QFile>
+class QPoint;
+class Maze;
+
+// Append-only record of the moves made since the maze was last saved
+class Journal
+{
+public:
+	Journal();
+
+	int size() const
+		{ return m_size; }
+
+	void reset(const QString& filename);
+	void open(const QString& filename, int entries);
+	void discard();
+	void recordMove(const QPoint& player, int marker, int rotation, int msecs);
+	void recordFlag(const QPoint& cell, int msecs);
+	int replay(const QString& filename, Maze* maze, QPoint& player, int& rotation, int& steps, int& msecs) const;
+
+private:
+	void write(int type, const QPoint& cell, int marker, int rotation, int msecs);
+
+	QFile m_file;
+	int m_size;
+};
+
+#endif // JOURNAL_H
@@ -19,49 +19,53 @@
 
 #include "maze.h"
 
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QSettings>
+#include <QTime>
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#include <cstdio>
+#include <unistd.h>
+#elif defined(Q_OS_WIN32)
+#include <io.h>
+#include <windows.h>
+#endif
 
 namespace {
 // ============================================================================
 
-QPoint randomNeighbor(QVector< QVector<bool> >& visited, const QPoint& cell)
+QPoint randomNeighbor(QVector<bool>& visited, const QPoint& cell, int columns, int rows)
 {
 	// Find unvisited neighbors
 	QPoint neighbors[4];
 	int found = 0;
-	if (cell.x() > 0) {
-		QPoint n(cell.x() - 1, cell.y());
-		if (visited.at(n.x()).at(n.y()) == false) {
-			neighbors[found] = n;
-			found++;
-		}
+	int index = cell.y() * columns + cell.x();
+	if (cell.x() > 0 && visited.at(index - 1) == false) {
+		neighbors[found] = QPoint(cell.x() - 1, cell.y());
+		found++;
 	}
-	if (cell.y() > 0) {
-		QPoint n(cell.x(), cell.y() - 1);
-		if (visited.at(n.x()).at(n.y()) == false) {
-			neighbors[found] = n;
-			found++;
-		}
+	if (cell.y() > 0 && visited.at(index - columns) == false) {
+		neighbors[found] = QPoint(cell.x(), cell.y() - 1);
+		found++;
 	}
-	if (cell.y() < visited.at(cell.x()).size() - 1) {
-		QPoint n(cell.x(), cell.y() + 1);
-		if (visited.at(n.x()).at(n.y()) == false) {
-			neighbors[found] = n;
-			found++;
-		}
+	if (cell.y() < rows - 1 && visited.at(index + columns) == false) {
+		neighbors[found] = QPoint(cell.x(), cell.y() + 1);
+		found++;
 	}
-	if (cell.x() < visited.size() - 1) {
-		QPoint n(cell.x() + 1, cell.y());
-		if (visited.at(n.x()).at(n.y()) == false) {
-			neighbors[found] = n;
-			found++;
-		}
+	if (cell.x() < columns - 1 && visited.at(index + 1) == false) {
+		neighbors[found] = QPoint(cell.x() + 1, cell.y());
+		found++;
 	}
 
 	// Return random neighbor
 	if (found) {
 		const QPoint& n = neighbors[rand() % found];
-		visited[n.x()][n.y()] = true;
+		visited[n.y() * columns + n.x()] = true;
 		return n;
 	} else {
 		return QPoint(-1,-1);
@@ -69,23 +73,108 @@ QPoint randomNeighbor(QVector< QVector<bool> >& visited, const QPoint& cell)
 }
 
 // ============================================================================
+
+// Returns the peak resident set size of the process in kilobytes
+long peakResidentMemory()
+{
+#if defined(Q_OS_UNIX)
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#if defined(Q_OS_MAC)
+		return usage.ru_maxrss / 1024;
+#else
+		return usage.ru_maxrss;
+#endif
+	}
+#endif
+	return 0;
 }
 
+// ============================================================================
+
+// Save file header: magic, version, columns, rows, planes, and payload size
+const quint32 save_magic = 0x434d5356; // "CMSV"
+const quint32 save_version = 1;
+const int save_header_size = 24;
+
+// Bitplanes in a save file: the flag, then the three bits of the path marker
+const int save_planes = 4;
+
+// Returns the location of the save file, kept apart for each application
+QString saveFilePath()
+{
+#if defined(Q_OS_MAC)
+	QString path = QDir::homePath() + "/Library/Application Support/GottCode/CuteMaze";
+#elif defined(Q_OS_UNIX)
+	QString path = getenv("XDG_DATA_HOME");
+	if (path.isEmpty()) {
+		path = QDir::homePath() + "/.local/share";
+	}
+	path += "/games/cutemaze";
+#elif defined(Q_OS_WIN32)
+	QString path = QDir::homePath() + "/Application Data/GottCode/CuteMaze";
+#endif
+	return path + "/" + QCoreApplication::applicationName().toLower().replace(' ', '-') + ".save";
+}
+
+// ============================================================================
+
+// Puts a written file on disk in place of path, so that there is always
+// either the previous or the new file under that name
+bool replaceFile(QFile& file, const QString& path)
+{
+	if (!file.flush()) {
+		return false;
+	}
+#if defined(Q_OS_UNIX)
+	bool synced = (fsync(file.handle()) == 0);
+	file.close();
+	return synced && (rename(QFile::encodeName(file.fileName()).constData(), QFile::encodeName(path).constData()) == 0);
+#elif defined(Q_OS_WIN32)
+	bool synced = (_commit(file.handle()) == 0);
+	file.close();
+	return synced && MoveFileExW(reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(file.fileName()).utf16()),
+		reinterpret_cast<const wchar_t*>(QDir::toNativeSeparators(path).utf16()),
+		MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+	file.close();
+	QFile::remove(path);
+	return QFile::rename(file.fileName(), path);
+#endif
+}
+
+// ============================================================================
+}
+
+// Random numbers
+// ============================================================================
+
+int randomIndex(int max)
+{
+	if (max <= RAND_MAX) {
+		return rand() % max;
+	}
+	quint64 value = (quint64(rand()) * (quint64(RAND_MAX) + 1)) + rand();
+	return value % max;
+}
+
+// ============================================================================
+
 // Hunt and Kill algorithm
 // ============================================================================
 
 void HuntAndKillMaze::generate()
 {
-	m_visited = QVector< QVector<bool> >(columns(), QVector<bool>(rows()));
+	m_visited = QVector<bool>(columns() * rows(), false);
 	m_unvisited = columns() * rows();
 
 	QPoint current(0, rand() % rows());
-	m_visited[current.x()][current.y()] = true;
+	m_visited[current.y() * columns()] = true;
 	m_unvisited--;
 
 	QPoint neighbor;
-	while (m_unvisited) {
-		neighbor = randomNeighbor(m_visited, current);
+	while (m_unvisited && !isCanceled()) {
+		neighbor = randomNeighbor(m_visited, current, columns(), rows());
 		if (neighbor.x() != -1) {
 			mergeCells(current, neighbor);
 			current = neighbor;
@@ -114,7 +203,7 @@ QPoint HuntAndKillMaze::hunt()
 		cell.setX(c);
 		for (int r = 0; r < rows(); ++r) {
 			cell.setY(r);
-			if (m_visited.at(c).at(r)) {
+			if (m_visited.at(r * columns() + c)) {
 				continue;
 			}
 			for (int d = 0; d < 4; ++d) {
@@ -125,9 +214,9 @@ QPoint HuntAndKillMaze::hunt()
 					next.y() >= rows()) {
 					continue;
 				}
-				if (m_visited.at(next.x()).at(next.y())) {
+				if (m_visited.at(next.y() * columns() + next.x())) {
 					mergeCells(cell, next);
-					m_visited[c][r] = true;
+					m_visited[r * columns() + c] = true;
 					m_unvisited--;
 					return cell;
 				}
@@ -139,25 +228,96 @@ QPoint HuntAndKillMaze::hunt()
 
 // ============================================================================
 
+// Hunt and Kill algorithm with a hunt cursor
+// ============================================================================
+
+void FastHuntAndKillMaze::generate()
+{
+	m_visited = QVector<bool>(columns() * rows(), false);
+	m_row_unvisited = QVector<int>(rows(), columns());
+	m_unvisited = columns() * rows();
+
+	// Start in the first cell hunted, so that every cell before the cursor
+	// is always visited
+	m_cursor = QPoint(0, 0);
+	QPoint current = m_cursor;
+	visit(current);
+
+	QPoint neighbor;
+	while (m_unvisited && !isCanceled()) {
+		neighbor = randomNeighbor(m_visited, current, columns(), rows());
+		if (neighbor.x() != -1) {
+			mergeCells(current, neighbor);
+			current = neighbor;
+			m_row_unvisited[current.y()]--;
+			m_unvisited--;
+		} else {
+			current = hunt();
+		}
+	}
+
+	m_visited.clear();
+	m_row_unvisited.clear();
+}
+
+// ============================================================================
+
+void FastHuntAndKillMaze::visit(const QPoint& cell)
+{
+	m_visited[cell.y() * columns() + cell.x()] = true;
+	m_row_unvisited[cell.y()]--;
+	m_unvisited--;
+}
+
+// ============================================================================
+
+QPoint FastHuntAndKillMaze::hunt()
+{
+	// Skip rows that are fully visited
+	while (m_row_unvisited.at(m_cursor.y()) == 0) {
+		m_cursor = QPoint(0, m_cursor.y() + 1);
+	}
+
+	// Resume from the last unvisited cell found
+	int index = m_cursor.y() * columns();
+	while (m_visited.at(index + m_cursor.x())) {
+		m_cursor.rx()++;
+	}
+
+	// Every cell before the cursor is visited, so join the cell to its left
+	// or above it
+	QPoint cell = m_cursor;
+	Q_ASSERT(cell.x() > 0 || cell.y() > 0);
+	if (cell.x() > 0) {
+		mergeCells(cell, QPoint(cell.x() - 1, cell.y()));
+	} else {
+		mergeCells(cell, QPoint(cell.x(), cell.y() - 1));
+	}
+	visit(cell);
+	return cell;
+}
+
+// ============================================================================
+
 // Kruskal's algorithm
 // ============================================================================
 
 void KruskalMaze::generate()
 {
 	// Generate sets
-	m_set_ids = QVector< QVector<Set*> >(columns(), QVector<Set*>(rows()));
+	m_set_ids = QVector<Set*>(columns() * rows());
 	for (int c = 0; c < columns(); ++c) {
 		for (int r = 0; r < rows(); ++r) {
 			m_sets.append(QList<QPoint>() << QPoint(c, r));
-			m_set_ids[c][r] = &m_sets.last();
+			m_set_ids[r * columns() + c] = &m_sets.last();
 		}
 	}
 
-	while (m_sets.size() > 1) {
+	while (m_sets.size() > 1 && !isCanceled()) {
 		Set* set1 = &m_sets.first();
 
 		// Find random cell
-		const QPoint& cell = set1->at(rand() % set1->size());
+		const QPoint& cell = set1->at(randomIndex(set1->size()));
 
 		// Find random neighbor of cell
 		QPoint cell2(cell);
@@ -171,7 +331,7 @@ void KruskalMaze::generate()
 		}
 
 		// Find set containing second cell
-		Set* set2 = m_set_ids.at(cell2.x()).at(cell2.y());
+		Set* set2 = m_set_ids.at(cell2.y() * columns() + cell2.x());
 
 		// Merge sets if they are different
 		if (set1 != set2) {
@@ -179,7 +339,7 @@ void KruskalMaze::generate()
 			int size = set1->size();
 			for (int i = 0; i < size; ++i) {
 				const QPoint& cell3 = set1->at(i);
-				m_set_ids[cell3.x()][cell3.y()] = set2;
+				m_set_ids[cell3.y() * columns() + cell3.x()] = set2;
 			}
 			*set2 += *set1;
 			m_sets.removeFirst();
@@ -192,24 +352,115 @@ void KruskalMaze::generate()
 
 // ============================================================================
 
+// Kruskal's algorithm using a disjoint-set forest
+// ============================================================================
+
+void FastKruskalMaze::generate()
+{
+	int cells = columns() * rows();
+	m_parents = QVector<int>(cells);
+	for (int i = 0; i < cells; ++i) {
+		m_parents[i] = i;
+	}
+	m_ranks = QVector<unsigned char>(cells, 0);
+
+	// Each edge is stored as cell * 2, plus 1 if it joins the cell below
+	// instead of the cell to the right
+	QVector<int> edges;
+	edges.reserve(cells * 2);
+	for (int r = 0; r < rows(); ++r) {
+		for (int c = 0; c < columns(); ++c) {
+			int cell = r * columns() + c;
+			if (c < columns() - 1) {
+				edges.append(cell * 2);
+			}
+			if (r < rows() - 1) {
+				edges.append(cell * 2 + 1);
+			}
+		}
+	}
+
+	// Pick edges in random order until every cell is in one set
+	int remaining = cells - 1;
+	for (int size = edges.size(); remaining && size > 0 && !isCanceled(); --size) {
+		int pos = randomIndex(size);
+		int edge = edges.at(pos);
+		edges[pos] = edges.at(size - 1);
+
+		int cell1 = edge >> 1;
+		int cell2 = cell1 + ((edge & 1) ? columns() : 1);
+		if (unionSets(cell1, cell2)) {
+			mergeCells(QPoint(cell1 % columns(), cell1 / columns()), QPoint(cell2 % columns(), cell2 / columns()));
+			remaining--;
+		}
+	}
+
+	m_parents.clear();
+	m_ranks.clear();
+}
+
+// ============================================================================
+
+int FastKruskalMaze::findSet(int cell)
+{
+	// Find root of set
+	int root = cell;
+	while (m_parents.at(root) != root) {
+		root = m_parents.at(root);
+	}
+
+	// Compress path to root
+	while (m_parents.at(cell) != root) {
+		int next = m_parents.at(cell);
+		m_parents[cell] = root;
+		cell = next;
+	}
+
+	return root;
+}
+
+// ============================================================================
+
+bool FastKruskalMaze::unionSets(int cell1, int cell2)
+{
+	int root1 = findSet(cell1);
+	int root2 = findSet(cell2);
+	if (root1 == root2) {
+		return false;
+	}
+
+	// Attach shorter tree to taller tree
+	if (m_ranks.at(root1) < m_ranks.at(root2)) {
+		m_parents[root1] = root2;
+	} else if (m_ranks.at(root1) > m_ranks.at(root2)) {
+		m_parents[root2] = root1;
+	} else {
+		m_parents[root2] = root1;
+		m_ranks[root1]++;
+	}
+	return true;
+}
+
+// ============================================================================
+
 // Prim's algorithm
 // ============================================================================
 
 void PrimMaze::generate()
 {
 	// Generate cell lists
-	m_regions = QVector< QVector<int> >(columns(), QVector<int>(rows(), 0));
+	m_regions = QVector<int>(columns() * rows(), 0);
 
 	// Move first cell
-	QPoint cell(0, rand() % columns());
-	m_regions[0][cell.y()] = 2;
+	QPoint cell(0, rand() % rows());
+	m_regions[cell.y() * columns()] = 2;
 	moveNeighbors(cell);
 
 	// Move remaining cells
-	while (!m_frontier.isEmpty()) {
-		cell = m_frontier.takeAt( rand() % m_frontier.size() );
+	while (!m_frontier.isEmpty() && !isCanceled()) {
+		cell = m_frontier.takeAt( randomIndex(m_frontier.size()) );
 		mergeRandomNeighbor(cell);
-		m_regions[cell.x()][cell.y()] = 2;
+		m_regions[cell.y() * columns() + cell.x()] = 2;
 		moveNeighbors(cell);
 	}
 
@@ -223,7 +474,7 @@ void PrimMaze::moveNeighbors(const QPoint& cell)
 	QList<QPoint> n = neighbors(cell);
 	for (int i = 0; i < n.size(); ++i) {
 		const QPoint& current = n.at(i);
-		int& ref = m_regions[current.x()][current.y()];
+		int& ref = m_regions[current.y() * columns() + current.x()];
 		if (ref == 0) {
 			ref = 1;
 			m_frontier.append(current);
@@ -240,12 +491,12 @@ void PrimMaze::mergeRandomNeighbor(const QPoint& cell)
 	QList<QPoint> n = neighbors(cell);
 	for (int i = 0; i < n.size(); ++i) {
 		const QPoint& current = n.at(i);
-		if (m_regions.at(current.x()).at(current.y()) == 2) {
+		if (m_regions.at(current.y() * columns() + current.x()) == 2) {
 			cells.append(current);
 		}
 	}
 
-	mergeCells( cell, cells.at(rand() % cells.size()) );
+	mergeCells( cell, cells.at(randomIndex(cells.size())) );
 }
 
 // ============================================================================
@@ -270,59 +521,115 @@ QList<QPoint> PrimMaze::neighbors(const QPoint& cell)
 
 // ============================================================================
 
-// Recursive Backtracker algorithm
+// Prim's algorithm using a flat frontier
 // ============================================================================
 
-void RecursiveBacktrackerMaze::generate()
+void FastPrimMaze::generate()
 {
-	m_visited = QVector< QVector<bool> >(columns(), QVector<bool>(rows()));
+	m_regions = QVector<unsigned char>(columns() * rows(), Outside);
+	m_frontier.reserve(columns() + rows());
 
-	QPoint start(0, rand() % rows());
-	m_visited[start.x()][start.y()] = true;
-	makePath(start);
+	// Move first cell
+	int cell = randomIndex(rows()) * columns();
+	m_regions[cell] = Inside;
+	moveNeighbors(cell);
 
-	m_visited.clear();
+	// Move remaining cells, removing random picks by swapping in the last
+	while (!m_frontier.isEmpty() && !isCanceled()) {
+		int pos = randomIndex(m_frontier.size());
+		cell = m_frontier.at(pos);
+		m_frontier[pos] = m_frontier.last();
+		m_frontier.remove(m_frontier.size() - 1);
+
+		mergeRandomNeighbor(cell);
+		m_regions[cell] = Inside;
+		moveNeighbors(cell);
+	}
+
+	m_frontier.clear();
+	m_regions.clear();
 }
 
 // ============================================================================
 
-void RecursiveBacktrackerMaze::makePath(const QPoint& current)
+void FastPrimMaze::moveNeighbors(int cell)
 {
-	QPoint neighbor;
-	while ( (neighbor = randomNeighbor(m_visited, current)).x() != -1 ) {
-		mergeCells(current, neighbor);
-		makePath(neighbor);
+	int column = cell % columns();
+	int row = cell / columns();
+	int neighbors[4];
+	int found = 0;
+	if (column > 0) {
+		neighbors[found++] = cell - 1;
+	}
+	if (row > 0) {
+		neighbors[found++] = cell - columns();
+	}
+	if (row < rows() - 1) {
+		neighbors[found++] = cell + columns();
+	}
+	if (column < columns() - 1) {
+		neighbors[found++] = cell + 1;
+	}
+
+	for (int i = 0; i < found; ++i) {
+		unsigned char& region = m_regions[neighbors[i]];
+		if (region == Outside) {
+			region = Frontier;
+			m_frontier.append(neighbors[i]);
+		}
 	}
 }
 
 // ============================================================================
 
-// Stack algorithm
+void FastPrimMaze::mergeRandomNeighbor(int cell)
+{
+	int column = cell % columns();
+	int row = cell / columns();
+	QPoint cells[4];
+	int found = 0;
+	if (column > 0 && m_regions.at(cell - 1) == Inside) {
+		cells[found++] = QPoint(column - 1, row);
+	}
+	if (row > 0 && m_regions.at(cell - columns()) == Inside) {
+		cells[found++] = QPoint(column, row - 1);
+	}
+	if (row < rows() - 1 && m_regions.at(cell + columns()) == Inside) {
+		cells[found++] = QPoint(column, row + 1);
+	}
+	if (column < columns() - 1 && m_regions.at(cell + 1) == Inside) {
+		cells[found++] = QPoint(column + 1, row);
+	}
+
+	Q_ASSERT(found > 0);
+	mergeCells(QPoint(column, row), cells[rand() % found]);
+}
+
+// ============================================================================
+
+// Recursive Backtracker algorithm
 // ============================================================================
 
-void StackMaze::generate()
+void RecursiveBacktrackerMaze::generate()
 {
-	// Generate cell lists
-	m_visited = QVector< QVector<bool> >(columns(), QVector<bool>(rows()));
-	QList<QPoint> active;
+	m_visited = QVector<bool>(columns() * rows(), false);
 
-	// Start maze
 	QPoint start(0, rand() % rows());
-	m_visited[start.x()][start.y()] = true;
-	active.append(start);
-
-	// Loop through active list
-	QPoint cell, neighbor;
-	int pos;
-	while (!active.isEmpty()) {
-		pos = nextActive(active.size());
-		cell = active.at(pos);
-		neighbor = randomNeighbor(m_visited, cell);
+	m_visited[start.y() * columns()] = true;
+
+	// Walk the path with an explicit stack so depth is not limited by the
+	// thread's stack size; cells are visited in the same order as recursion
+	QVector<QPoint> path;
+	path.append(start);
+	QPoint current, neighbor;
+	while (!path.isEmpty() && !isCanceled()) {
+		current = path.last();
+		neighbor = randomNeighbor(m_visited, current, columns(), rows());
 		if (neighbor.x() != -1) {
-			mergeCells(cell, neighbor);
-			active.append(neighbor);
+			mergeCells(current, neighbor);
+			path.append(neighbor);
 		} else {
-			active.takeAt(pos);
+			path.remove(path.size() - 1);
 		}
 	}
 
@@ -331,71 +638,277 @@ void StackMaze::generate()
 
 // ============================================================================
 
-int StackMaze::nextActive(int size)
+// Growing tree policies
+// ============================================================================
+
+WeightedCell::WeightedCell(int oldest, int random, int newest)
+:	m_oldest(oldest),
+	m_random(random),
+	m_total(oldest + random + newest)
 {
-	return size - 1;
+	Q_ASSERT(m_total > 0);
 }
 
 // ============================================================================
 
-int Stack2Maze::nextActive(int size)
+int WeightedCell::operator()(int size)
 {
-	if (rand() % 2 != 0) {
-		return size - 1;
+	int choice = rand() % m_total;
+	if (choice < m_oldest) {
+		return 0;
+	} else if (choice < m_oldest + m_random) {
+		return randomIndex(size);
 	} else {
-		return rand() % (size);
+		return size - 1;
 	}
 }
 
 // ============================================================================
 
-int Stack3Maze::nextActive(int size)
+// Maze class
+// ============================================================================
+
+Maze::Maze()
+:	m_columns(0),
+	m_rows(0),
+	m_generation_time(0),
+	m_peak_memory(0),
+	m_merged(0),
+	m_progress(0),
+	m_canceled(0)
 {
-	return rand() % size;
 }
 
 // ============================================================================
 
-int Stack4Maze::nextActive(int size)
+Maze* Maze::create(int algorithm)
 {
-	int recent = 3 < size ? 3 : size;
-	return size - (rand() % recent) - 1;
+	switch (algorithm) {
+	case 0:
+		return new HuntAndKillMaze;
+	case 1:
+		return new KruskalMaze;
+	case 2:
+		return new PrimMaze;
+	case 3:
+		return new RecursiveBacktrackerMaze;
+	case 5:
+		return new GrowingTreeMaze<WeightedCell>(WeightedCell(0, 1, 1));
+	case 6:
+		return new GrowingTreeMaze<RandomCell>;
+	case 7:
+		return new GrowingTreeMaze< RecentCell<3> >;
+	case 8:
+		return new GrowingTreeMaze<WeightedCell>(WeightedCell(1, 1, 1));
+	case 9:
+		return new FastKruskalMaze;
+	case 10:
+		return new FastPrimMaze;
+	case 11:
+		return new FastHuntAndKillMaze;
+	case 4:
+	default:
+		return new GrowingTreeMaze<NewestCell>;
+	}
 }
 
 // ============================================================================
 
-int Stack5Maze::nextActive(int size)
+// The original Hunt and Kill, Kruskal and Prim engines are too slow for large
+// mazes, so those use the faster engine for the same algorithm
+int Maze::largeAlgorithm(int algorithm)
 {
-	switch (rand() % 3) {
+	switch (algorithm) {
 	case 0:
-		return 0;
+		return 11;
 	case 1:
-		return rand() % size;
+		return 9;
 	case 2:
+		return 10;
 	default:
-		return size - 1;
+		return algorithm;
 	}
 }
 
 // ============================================================================
 
-// Maze class
-// ============================================================================
-
 void Maze::generate(int columns, int rows)
 {
+	Q_ASSERT(columns > 1 && columns <= MaximumSize);
+	Q_ASSERT(rows > 1 && rows <= MaximumSize);
+
+	QTime time;
+	time.start();
+
 	m_columns = columns;
 	m_rows = rows;
-	m_cells = QVector< QVector<Cell> >(m_columns, QVector<Cell>(m_rows));
+	m_cells = QVector<Cell>(m_columns * m_rows);
+	m_merged = 0;
+	m_progress = 0;
 	generate();
+	m_progress = 100;
+
+	m_generation_time = time.elapsed();
+	updatePeakMemory();
+}
+
+// ============================================================================
+
+void Maze::updatePeakMemory()
+{
+	m_peak_memory = peakResidentMemory();
 }
 
 // ============================================================================
 
 bool Maze::load()
 {
-	// Read data from disk
-	QByteArray data = QSettings().value("Current/Progress").toByteArray();
+	// Read save file, falling back to progress stored by older versions
+	QSettings settings;
+	if (settings.contains("Current/SaveFile")) {
+		return loadFile(settings.value("Current/SaveFile").toString());
+	}
+	return loadProgress(settings.value("Current/Progress").toByteArray());
+}
+
+// ============================================================================
+
+bool Maze::save(const QString& path) const
+{
+	// Pack flags and path markers into bitplanes
+	int count = m_columns * m_rows;
+	int plane_size = (count + 7) / 8;
+	QByteArray planes(plane_size * save_planes, 0);
+	uchar* flags = reinterpret_cast<uchar*>(planes.data());
+	uchar* markers = flags + plane_size;
+	for (int i = 0; i < count; ++i) {
+		const Cell& cell = m_cells.at(i);
+		int byte = i >> 3;
+		uchar bit = 1 << (i & 7);
+		if (cell.flag()) {
+			flags[byte] |= bit;
+		}
+		int marker = cell.pathMarker() / 90;
+		for (int plane = 0; marker; ++plane, marker >>= 1) {
+			if (marker & 1) {
+				markers[plane * plane_size + byte] |= bit;
+			}
+		}
+	}
+
+	// Compress at the fastest level, since the planes are mostly empty
+	QByteArray payload = qCompress(planes, 1);
+
+	// Write to a temporary file and then replace the previous save
+	if (!QDir().mkpath(QFileInfo(path).absolutePath())) {
+		return false;
+	}
+	QFile file(path + ".new");
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning("Unable to write save file %s", qPrintable(file.fileName()));
+		return false;
+	}
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_3);
+	stream << save_magic << save_version << quint32(m_columns) << quint32(m_rows) << quint32(save_planes) << quint32(payload.size());
+	stream.writeRawData(payload.constData(), payload.size());
+	if (stream.status() != QDataStream::Ok || !replaceFile(file, path)) {
+		qWarning("Unable to write save file %s", qPrintable(path));
+		file.remove();
+		return false;
+	}
+	return true;
+}
+
+// ============================================================================
+
+QString Maze::nextSaveFile()
+{
+	// Alternate between two files, so that the current save is kept until
+	// the settings point at its replacement
+	QString path = saveFilePath();
+	if (QSettings().value("Current/SaveFile").toString() == path) {
+		path.insert(path.length() - 5, "-2");
+	}
+	return path;
+}
+
+// ============================================================================
+
+bool Maze::loadFile(const QString& path)
+{
+	// Map file into memory
+	QFile file(path);
+	if (!file.open(QIODevice::ReadOnly) || file.size() < save_header_size) {
+		return false;
+	}
+	const uchar* data = file.map(0, file.size());
+	if (!data) {
+		return false;
+	}
+
+	// Check header
+	QByteArray header = QByteArray::fromRawData(reinterpret_cast<const char*>(data), save_header_size);
+	QDataStream stream(header);
+	stream.setVersion(QDataStream::Qt_4_3);
+	quint32 magic, version, columns, rows, planes, size;
+	stream >> magic >> version >> columns >> rows >> planes >> size;
+	if (stream.status() != QDataStream::Ok
+		|| magic != save_magic
+		|| version != save_version
+		|| columns != quint32(m_columns)
+		|| rows != quint32(m_rows)
+		|| planes != quint32(save_planes)
+		|| size > file.size() - save_header_size) {
+		return false;
+	}
+
+	// Decompress straight from the mapped file
+	int count = m_columns * m_rows;
+	int plane_size = (count + 7) / 8;
+	QByteArray unpacked = qUncompress(data + save_header_size, size);
+	if (unpacked.size() != plane_size * save_planes) {
+		return false;
+	}
+
+	// Unpack bitplanes, skipping bytes without any flags or path markers
+	const uchar* flags = reinterpret_cast<const uchar*>(unpacked.constData());
+	const uchar* markers = flags + plane_size;
+	for (int byte = 0; byte < plane_size; ++byte) {
+		uchar flag_bits = flags[byte];
+		uchar marker_bits[3] = { markers[byte], markers[plane_size + byte], markers[2 * plane_size + byte] };
+		if (!(flag_bits | marker_bits[0] | marker_bits[1] | marker_bits[2])) {
+			continue;
+		}
+
+		int end = qMin(byte * 8 + 8, count);
+		for (int i = byte * 8; i < end; ++i) {
+			uchar bit = 1 << (i & 7);
+			Cell& cell = m_cells[i];
+			if (bool(flag_bits & bit) != cell.flag()) {
+				cell.toggleFlag();
+			}
+			int marker = 0;
+			for (int plane = 0; plane < 3; ++plane) {
+				if (marker_bits[plane] & bit) {
+					marker |= 1 << plane;
+				}
+			}
+			if (marker > 4) {
+				return false;
+			} else if (marker) {
+				cell.setPathMarker(marker * 90);
+			}
+		}
+	}
+
+	return true;
+}
+
+// ============================================================================
+
+bool Maze::loadProgress(QByteArray data)
+{
 	if (data.isEmpty()) {
 		return false;
 	}
@@ -411,7 +924,7 @@ bool Maze::load()
 	stream.setVersion(QDataStream::Qt_4_3);
 	for (int c = 0; c < m_columns; ++c) {
 		for (int r = 0; r < m_rows; ++r) {
-			stream >> m_cells[c][r];
+			stream >> cellMutable(c, r);
 			if (stream.status() != QDataStream::Ok) {
 				return false;
 			}
@@ -427,44 +940,31 @@ bool Maze::load()
 
 // ============================================================================
 
-void Maze::save() const
+void Maze::mergeCells(const QPoint& cell1, const QPoint& cell2)
 {
-	// Serialize data
-	QByteArray data;
-	QDataStream stream(&data, QIODevice::WriteOnly);
-	stream.setVersion(QDataStream::Qt_4_3);
-	for (int c = 0; c < m_columns; ++c) {
-		for (int r = 0; r < m_rows; ++r) {
-			stream << m_cells[c][r];
-		}
+	// Every generator merges each cell but the first exactly once
+	m_merged++;
+	if ((m_merged & 0xfff) == 0) {
+		m_progress = (qint64(m_merged) * 100) / (m_columns * m_rows);
 	}
 
-	// Compress data
-	data = qCompress(data, 9);
-
-	// Write data to disk
-	QSettings().setValue("Current/Progress", data);
-}
-
-// ============================================================================
-
-void Maze::mergeCells(const QPoint& cell1, const QPoint& cell2)
-{
+	Cell& first = cellMutable(cell1.x(), cell1.y());
+	Cell& second = cellMutable(cell2.x(), cell2.y());
 	if (cell1.y() == cell2.y()) {
 		if (cell2.x() > cell1.x()) {
-			m_cells[cell1.x()][cell1.y()].removeRightWall();
-			m_cells[cell2.x()][cell2.y()].removeLeftWall();
+			first.removeRightWall();
+			second.removeLeftWall();
 		} else if (cell2.x() < cell1.x()) {
-			m_cells[cell1.x()][cell1.y()].removeLeftWall();
-			m_cells[cell2.x()][cell2.y()].removeRightWall();
+			first.removeLeftWall();
+			second.removeRightWall();
 		}
 	} else if (cell1.x() == cell2.x()) {
 		if (cell2.y() > cell1.y()) {
-			m_cells[cell1.x()][cell1.y()].removeBottomWall();
-			m_cells[cell2.x()][cell2.y()].removeTopWall();
+			first.removeBottomWall();
+			second.removeTopWall();
 		} else if (cell2.y() < cell1.y()) {
-			m_cells[cell1.x()][cell1.y()].removeTopWall();
-			m_cells[cell2.x()][cell2.y()].removeBottomWall();
+			first.removeTopWall();
+			second.removeBottomWall();
 		}
 	}
 }
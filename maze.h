@@ -22,38 +22,79 @@
 
 #include "cell.h"
 
+#include <QAtomicInt>
+#include <QBitArray>
 #include <QList>
 #include <QPoint>
 #include <QVector>
 
+#include <cstdlib>
+
+class QByteArray;
+class QString;
+
+// Returns a random value from 0 to max - 1, even if max exceeds RAND_MAX
+int randomIndex(int max);
+
 class Maze
 {
 public:
+	Maze();
 	virtual ~Maze()
 		{ }
 
+	enum {
+		MinimumSize = 10,
+		MaximumSize = 4096,
+		AlgorithmCount = 12
+	};
+
+	static Maze* create(int algorithm);
+	static int largeAlgorithm(int algorithm);
+
 	int columns() const
 		{ return m_columns; }
 	int rows() const
 		{ return m_rows; }
 	const Cell& cell(int column, int row) const
-		{ return m_cells.at(column).at(row); }
+		{ return m_cells.at(row * m_columns + column); }
 	Cell& cellMutable(int column, int row)
-		{ return m_cells[column][row]; }
+		{ return m_cells[row * m_columns + column]; }
 
 	void generate(int columns, int rows);
+	int generationTime() const
+		{ return m_generation_time; }
+	long peakMemory() const
+		{ return m_peak_memory; }
+	void updatePeakMemory();
+
+	// Safe to call from other threads while the maze is generating
+	int progress() const
+		{ return m_progress; }
+	void cancel()
+		{ m_canceled = 1; }
+	bool isCanceled() const
+		{ return m_canceled != 0; }
 	bool load();
-	void save() const;
+	bool save(const QString& path) const;
+	static QString nextSaveFile();
 
 protected:
 	void mergeCells(const QPoint& cell1, const QPoint& cell2);
 
 private:
 	virtual void generate() = 0;
+	bool loadFile(const QString& path);
+	bool loadProgress(QByteArray data);
 
 	int m_columns;
 	int m_rows;
-	QVector< QVector<Cell> > m_cells;
+	QVector<Cell> m_cells; // row-major, one byte per cell
+	int m_generation_time;
+	long m_peak_memory;
+	int m_merged;
+	QAtomicInt m_progress;
+	QAtomicInt m_canceled;
 };
 
 
@@ -63,8 +104,22 @@ private:
 	virtual void generate();
 	QPoint hunt();
 
-	QVector< QVector<bool> > m_visited;
+	QVector<bool> m_visited;
+	int m_unvisited;
+};
+
+
+class FastHuntAndKillMaze : public Maze
+{
+private:
+	virtual void generate();
+	void visit(const QPoint& cell);
+	QPoint hunt();
+
+	QVector<bool> m_visited;
+	QVector<int> m_row_unvisited;
 	int m_unvisited;
+	QPoint m_cursor;
 };
 
 
@@ -75,7 +130,19 @@ private:
 
 	typedef QList<QPoint> Set;
 	QList<Set> m_sets;
-	QVector< QVector<Set*> > m_set_ids;
+	QVector<Set*> m_set_ids;
+};
+
+
+class FastKruskalMaze : public Maze
+{
+private:
+	virtual void generate();
+	int findSet(int cell);
+	bool unionSets(int cell1, int cell2);
+
+	QVector<int> m_parents;
+	QVector<unsigned char> m_ranks;
 };
 
 
@@ -88,7 +155,24 @@ private:
 	QList<QPoint> neighbors(const QPoint& cell);
 
 	QList<QPoint> m_frontier;
-	QVector< QVector<int> > m_regions;
+	QVector<int> m_regions;
+};
+
+
+class FastPrimMaze : public Maze
+{
+private:
+	virtual void generate();
+	void moveNeighbors(int cell);
+	void mergeRandomNeighbor(int cell);
+
+	enum Region {
+		Outside,
+		Frontier,
+		Inside
+	};
+	QVector<int> m_frontier;
+	QVector<unsigned char> m_regions;
 };
 
 
@@ -96,47 +180,119 @@ class RecursiveBacktrackerMaze : public Maze
 {
 private:
 	virtual void generate();
-	void makePath(const QPoint& current);
 
-	QVector< QVector<bool> > m_visited;
+	QVector<bool> m_visited;
 };
 
 
-class StackMaze : public Maze
+// Growing tree algorithm; the policy picks which active cell grows next and
+// is called as policy(size) with the number of active cells
+template <typename Policy>
+class GrowingTreeMaze : public Maze
 {
+public:
+	GrowingTreeMaze(const Policy& policy = Policy())
+	:	m_policy(policy)
+		{ }
+
 private:
 	virtual void generate();
-	virtual int nextActive(int size);
 
-	QVector< QVector<bool> > m_visited;
+	Policy m_policy;
+	QBitArray m_visited;
 };
 
 
-class Stack2Maze : public StackMaze
+// Growing tree policies
+struct NewestCell
 {
-private:
-	virtual int nextActive(int size);
+	int operator()(int size)
+		{ return size - 1; }
 };
 
 
-class Stack3Maze : public StackMaze
+struct RandomCell
 {
-private:
-	virtual int nextActive(int size);
+	int operator()(int size)
+		{ return randomIndex(size); }
 };
 
 
-class Stack4Maze : public StackMaze
+template <int Count>
+struct RecentCell
 {
-private:
-	virtual int nextActive(int size);
+	int operator()(int size)
+	{
+		int recent = Count < size ? Count : size;
+		return size - (rand() % recent) - 1;
+	}
 };
 
 
-class Stack5Maze : public StackMaze
+class WeightedCell
 {
+public:
+	WeightedCell(int oldest, int random, int newest);
+
+	int operator()(int size);
+
 private:
-	virtual int nextActive(int size);
+	int m_oldest;
+	int m_random;
+	int m_total;
 };
 
+// ============================================================================
+
+template <typename Policy>
+void GrowingTreeMaze<Policy>::generate()
+{
+	const int columns = this->columns();
+	const int rows = this->rows();
+	m_visited = QBitArray(columns * rows);
+	QVector<int> active;
+	active.reserve(columns + rows);
+
+	// Start maze
+	int start = (rand() % rows) * columns;
+	m_visited.setBit(start);
+	active.append(start);
+
+	// Loop through active list
+	int neighbors[4];
+	while (!active.isEmpty() && !isCanceled()) {
+		int pos = m_policy(active.size());
+		int cell = active.at(pos);
+		int column = cell % columns;
+		int row = cell / columns;
+
+		// Find unvisited neighbors
+		int found = 0;
+		if (column > 0 && !m_visited.testBit(cell - 1)) {
+			neighbors[found++] = cell - 1;
+		}
+		if (row > 0 && !m_visited.testBit(cell - columns)) {
+			neighbors[found++] = cell - columns;
+		}
+		if (row < rows - 1 && !m_visited.testBit(cell + columns)) {
+			neighbors[found++] = cell + columns;
+		}
+		if (column < columns - 1 && !m_visited.testBit(cell + 1)) {
+			neighbors[found++] = cell + 1;
+		}
+
+		// Grow from cell or retire it
+		if (found) {
+			int neighbor = neighbors[rand() % found];
+			m_visited.setBit(neighbor);
+			mergeCells(QPoint(column, row), QPoint(neighbor % columns, neighbor / columns));
+			active.append(neighbor);
+		} else {
+			active.remove(pos);
+		}
+	}
+
+	m_visited.clear();
+}
+
 #endif // MAZE_H
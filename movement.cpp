@@ -0,0 +1,136 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "movement.h"
+
+#include "maze.h"
+
+// ============================================================================
+
+// <s> ADDED BY LARS PETTER MOSTAD
+// Based on old Board::move()
+int stepPlayer(const Maze* maze, QPoint& player, int& direction, bool first_step)
+{
+	Q_ASSERT(direction > 0 && direction < 5);
+
+	int angle = 0;
+	const Cell& cell = maze->cell(player.x(), player.y());
+
+	if(direction == 3)
+	{
+		angle = 270;
+		// See report for algorithm description
+		if( !cell.leftWall() && ( first_step || !cell.isFork() ) )
+		{
+			Q_ASSERT(player.x() > 0);player.rx()--;
+			direction = nextDirection(maze->cell(player.x(), player.y()), 3);
+		}
+		else
+		{
+			direction = 0;
+		}
+	}
+	else if(direction == 1)
+	{
+		angle = 90;
+		if( !cell.rightWall() && ( first_step || !cell.isFork() ) )
+		{
+			Q_ASSERT(player.x() < maze->columns() - 1);player.rx()++;
+			direction = nextDirection(maze->cell(player.x(), player.y()), 1);
+		}
+		else
+		{
+			direction = 0;
+		}
+	} 
+	else if(direction == 2)
+	{
+		angle = 360;
+		if( !cell.topWall() && ( first_step || !cell.isFork() ) )
+		{
+			Q_ASSERT(player.y() > 0);player.ry()--;
+			direction = nextDirection(maze->cell(player.x(), player.y()), 2);
+		}
+		else
+		{
+			direction = 0;
+		}
+	}
+	else if(direction == 4)
+	{
+		angle = 180;
+		if( !cell.bottomWall() && ( first_step || !cell.isFork() ) )
+		{
+			Q_ASSERT(player.y() < maze->rows() - 1);player.ry()++;
+			direction = nextDirection(maze->cell(player.x(), player.y()), 4);
+		}
+		else
+		{
+			direction = 0;
+		}
+	}
+
+	return angle;
+}
+// </s>
+
+// ============================================================================
+
+int stepPlayer(const Maze* maze, const CorridorGraph& corridors, CorridorGraph::Run& run, QPoint& player, int& direction, bool first_step)
+{
+	// Look at walls again when the player starts over or leaves the corridor,
+	// and carry the run along to wherever the player went
+	if (first_step || run.remaining == 0 || direction != corridors.heading(run)) {
+		QPoint from = player;
+		int angle = stepPlayer(maze, player, direction, first_step);
+		if (player != from) {
+			int way = (player.x() > from.x()) ? 1 : (player.y() < from.y()) ? 2 : (player.x() < from.x()) ? 3 : 4;
+			run = corridors.follow(run, from, way);
+		}
+		return angle;
+	}
+
+	static const int angles[5] = { 0, 90, 360, 270, 180 };
+	int angle = angles[corridors.advance(run, player)];
+	direction = run.remaining ? corridors.heading(run) : nextDirection(maze->cell(player.x(), player.y()), direction);
+	return angle;
+}
+
+// ============================================================================
+
+int nextDirection(const Cell& cell, int direction)
+{
+	// Ways to try in order for each direction of entering; never turn back
+	static const int ways[5][3] = {
+		{ 0, 0, 0 },
+		{ 1, 4, 2 },
+		{ 3, 2, 1 },
+		{ 3, 4, 2 },
+		{ 3, 4, 1 }
+	};
+	for (int i = 0; i < 3; ++i) {
+		int way = ways[direction][i];
+		if ((way == 1 && !cell.rightWall()) || (way == 2 && !cell.topWall()) || (way == 3 && !cell.leftWall()) || (way == 4 && !cell.bottomWall())) {
+			return way;
+		}
+	}
+	return 0;
+}
+
+// ============================================================================
@@ -0,0 +1,41 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef MOVEMENT_H
+#define MOVEMENT_H
+
+#include "corridors.h"
+class Cell;
+class QPoint;
+class Maze;
+
+// Moves the player one cell in direction (1 right, 2 up, 3 left, 4 down)
+// unless a wall blocks it, or a fork does after the first step, and picks the
+// direction to keep walking in, 0 to stop; returns the angle player now faces
+int stepPlayer(const Maze* maze, QPoint& player, int& direction, bool first_step);
+
+// Same as above, but walks through corridors along run, which it keeps up to
+// date, instead of looking at the walls of each cell; run starts from
+// CorridorGraph::locate() for where the player is
+int stepPlayer(const Maze* maze, const CorridorGraph& corridors, CorridorGraph::Run& run, QPoint& player, int& direction, bool first_step);
+
+// Picks the direction to keep walking in after entering cell, 0 to stop
+int nextDirection(const Cell& cell, int direction);
+
+#endif // MOVEMENT_H
@@ -0,0 +1,155 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "overview.h"
+
+#include "maze.h"
+
+#include <QPainter>
+#include <QVector>
+
+#include <cstring>
+
+// ============================================================================
+
+Overview::Overview()
+:	m_maze(0)
+{
+}
+
+// ============================================================================
+
+void Overview::setMaze(const Maze* maze)
+{
+	// Image is only built when first shown, as it is large for big mazes
+	m_maze = maze;
+	m_image = QImage();
+}
+
+// ============================================================================
+
+void Overview::updateCell(const QPoint& cell)
+{
+	if (m_image.isNull()) {
+		return;
+	}
+
+	int column = cell.x();
+	int row = cell.y();
+	int x = column * 2 + 1;
+	int y = row * 2 + 1;
+	m_image.scanLine(y)[x] = interior(column, row);
+
+	// Passages join the path to its neighbors
+	const Cell& current = m_maze->cell(column, row);
+	if (!current.leftWall()) {
+		m_image.scanLine(y)[x - 1] = passage(column - 1, row, column, row);
+	}
+	if (!current.rightWall()) {
+		m_image.scanLine(y)[x + 1] = passage(column, row, column + 1, row);
+	}
+	if (!current.topWall()) {
+		m_image.scanLine(y - 1)[x] = passage(column, row - 1, column, row);
+	}
+	if (!current.bottomWall()) {
+		m_image.scanLine(y + 1)[x] = passage(column, row, column, row + 1);
+	}
+}
+
+// ============================================================================
+
+void Overview::draw(QPainter& painter, const QRect& bounds, const QPoint& player, const QList<QPoint>& targets)
+{
+	if (!m_maze) {
+		return;
+	}
+	if (m_image.isNull()) {
+		build();
+	}
+
+	// Only sample the pixels that are shown, instead of converting the whole image
+	QImage image = m_image.scaled(bounds.size(), Qt::KeepAspectRatio, Qt::FastTransformation);
+	QPoint corner = bounds.topLeft() + QPoint((bounds.width() - image.width()) >> 1, (bounds.height() - image.height()) >> 1);
+	painter.drawImage(corner, image);
+
+	// Draw targets and player on top, large enough to be seen
+	qreal scale = qreal(image.width()) / m_image.width();
+	int size = qMax(3, qRound(scale * 2));
+	painter.setPen(Qt::NoPen);
+	painter.setBrush(Qt::blue);
+	foreach (QPoint target, targets) {
+		painter.drawRect(corner.x() + qRound((target.x() * 2 + 1) * scale), corner.y() + qRound((target.y() * 2 + 1) * scale), size, size);
+	}
+	painter.setBrush(Qt::red);
+	painter.drawEllipse(corner.x() + qRound((player.x() * 2 + 1) * scale) - 1, corner.y() + qRound((player.y() * 2 + 1) * scale) - 1, size + 2, size + 2);
+}
+
+// ============================================================================
+
+void Overview::build()
+{
+	int columns = m_maze->columns();
+	int rows = m_maze->rows();
+	int width = columns * 2 + 1;
+	int height = rows * 2 + 1;
+
+	m_image = QImage(width, height, QImage::Format_Indexed8);
+	QVector<QRgb> colors;
+	colors << qRgb(255, 255, 255) << qRgb(0, 0, 0) << qRgb(192, 192, 192) << qRgb(255, 128, 0);
+	m_image.setColorTable(colors);
+
+	// Fill each pair of scanlines from one row of cells
+	for (int r = 0; r < rows; ++r) {
+		uchar* top = m_image.scanLine(r * 2);
+		uchar* middle = m_image.scanLine(r * 2 + 1);
+		for (int c = 0; c < columns; ++c) {
+			const Cell& cell = m_maze->cell(c, r);
+			top[c * 2] = Wall;
+			top[c * 2 + 1] = cell.topWall() ? Wall : passage(c, r - 1, c, r);
+			middle[c * 2] = cell.leftWall() ? Wall : passage(c - 1, r, c, r);
+			middle[c * 2 + 1] = interior(c, r);
+		}
+		top[width - 1] = Wall;
+		middle[width - 1] = Wall;
+	}
+	memset(m_image.scanLine(height - 1), Wall, width);
+}
+
+// ============================================================================
+
+unsigned char Overview::interior(int column, int row) const
+{
+	const Cell& cell = m_maze->cell(column, row);
+	if (cell.flag()) {
+		return Flag;
+	} else if (cell.pathMarker()) {
+		return Path;
+	} else {
+		return Open;
+	}
+}
+
+// ============================================================================
+
+unsigned char Overview::passage(int column1, int row1, int column2, int row2) const
+{
+	return (m_maze->cell(column1, row1).pathMarker() && m_maze->cell(column2, row2).pathMarker()) ? Path : Open;
+}
+
+// ============================================================================
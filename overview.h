@@ -0,0 +1,56 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef OVERVIEW_H
+#define OVERVIEW_H
+
+#include <QImage>
+#include <QList>
+#include <QPoint>
+class QPainter;
+class QRect;
+class Maze;
+
+// Shows the whole maze, one pixel per cell, wall, and passage
+class Overview
+{
+public:
+	Overview();
+
+	void setMaze(const Maze* maze);
+	void updateCell(const QPoint& cell);
+	void draw(QPainter& painter, const QRect& bounds, const QPoint& player, const QList<QPoint>& targets);
+
+private:
+	void build();
+	unsigned char interior(int column, int row) const;
+	unsigned char passage(int column1, int row1, int column2, int row2) const;
+
+	enum Color {
+		Open,
+		Wall,
+		Path,
+		Flag
+	};
+
+	const Maze* m_maze;
+	QImage m_image;
+};
+
+#endif // OVERVIEW_H
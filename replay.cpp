@@ -0,0 +1,211 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#include "replay.h"
+
+#include "generator.h"
+#include "maze.h"
+#include "movement.h"
+
+#include <QDataStream>
+#include <QFile>
+
+// ============================================================================
+
+namespace
+{
+
+const quint32 replay_magic = 0x434d5250; // "CMRP"
+const quint32 replay_version = 1;
+const int event_size = 16; // moves, milliseconds, type, and value
+
+}
+
+// ============================================================================
+
+Replay::Replay()
+:	m_seed(0),
+	m_algorithm(0),
+	m_columns(0),
+	m_rows(0),
+	m_targets(0),
+	m_steps(-1),
+	m_msecs(0)
+{
+}
+
+// ============================================================================
+
+void Replay::start(unsigned int seed, int algorithm, int columns, int rows, int targets)
+{
+	m_seed = seed;
+	m_algorithm = algorithm;
+	m_columns = columns;
+	m_rows = rows;
+	m_targets = targets;
+	m_events.clear();
+	m_steps = -1;
+	m_msecs = 0;
+}
+
+// ============================================================================
+
+void Replay::record(int moves, int msecs, EventType type, int value)
+{
+	Event event = { moves, msecs, type, value };
+	m_events.append(event);
+	m_msecs = msecs;
+}
+
+// ============================================================================
+
+void Replay::finish(int steps, int msecs)
+{
+	m_steps = steps;
+	m_msecs = msecs;
+}
+
+// ============================================================================
+
+bool Replay::load(const QString& filename)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_3);
+
+	// Read header
+	quint32 magic, version;
+	qint32 count;
+	stream >> magic >> version;
+	if (magic != replay_magic || version != replay_version) {
+		return false;
+	}
+	stream >> m_seed >> m_algorithm >> m_columns >> m_rows >> m_targets >> m_steps >> m_msecs >> count;
+
+	// Only accept games that could have been played, so every player builds the same maze
+	if (stream.status() != QDataStream::Ok
+		|| m_algorithm < 0 || m_algorithm >= Maze::AlgorithmCount
+		|| m_columns < Maze::MinimumSize || m_columns > Maze::MaximumSize
+		|| m_rows < Maze::MinimumSize || m_rows > Maze::MaximumSize
+		|| m_targets < 1 || m_targets > Generator::MaximumTargets || m_targets >= m_columns * m_rows
+		|| count < 0 || count > (file.size() - file.pos()) / event_size) {
+		return false;
+	}
+
+	// Read events, which must be inputs the game can play back; a voice
+	// command that was not understood leaves the player standing
+	m_events.clear();
+	m_events.reserve(count);
+	for (int i = 0; i < count; ++i) {
+		Event event;
+		stream >> event.moves >> event.msecs >> event.type >> event.value;
+		if ((event.type == DirectionKey && (event.value < 1 || event.value > 4))
+				|| (event.type == VoiceCommand && (event.value < 0 || event.value > 4))
+				|| event.type < DirectionKey || event.type > VoiceCommand) {
+			m_events.clear();
+			return false;
+		}
+		m_events.append(event);
+	}
+	return stream.status() == QDataStream::Ok;
+}
+
+// ============================================================================
+
+bool Replay::save(const QString& filename) const
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qWarning("Unable to write replay %s", qPrintable(filename));
+		return false;
+	}
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_3);
+	stream << replay_magic << replay_version;
+	stream << m_seed << m_algorithm << m_columns << m_rows << m_targets << m_steps << m_msecs << m_events.size();
+	for (int i = 0; i < m_events.size(); ++i) {
+		const Event& event = m_events.at(i);
+		stream << event.moves << event.msecs << event.type << event.value;
+	}
+	return stream.status() == QDataStream::Ok;
+}
+
+// ============================================================================
+
+Replay::Result Replay::play() const
+{
+	Result result = { 0, 0, 0, QPoint(), false };
+
+	// Build the same maze and targets as the game did
+	Generator generator;
+	generator.generate(m_seed, m_algorithm, m_columns, m_rows, m_targets);
+	generator.wait();
+	Maze* maze = generator.takeMaze();
+	QPoint player = generator.startLocation();
+	QList<QPoint> targets = generator.targets();
+	CorridorGraph::Run run = generator.corridors().locate(maze, player);
+
+	// Follow the rules of Board::move() without timers or drawing
+	int direction = 0;
+	bool first_step = true;
+	int next = 0;
+	while (!targets.isEmpty()) {
+		// Apply inputs made before this move
+		for (; next < m_events.size() && m_events.at(next).moves == result.moves; ++next) {
+			const Event& event = m_events.at(next);
+			if (event.type != VoiceCommand) {
+				first_step = true;
+			}
+			if (event.type == DirectionKey || event.type == VoiceCommand) {
+				direction = event.value;
+			} else if (event.type == FlagKey) {
+				maze->cellMutable(player.x(), player.y()).toggleFlag();
+			}
+		}
+		if (direction < 1 || direction > 4) {
+			break;
+		}
+
+		// Move player, leaving a path marker behind
+		result.moves++;
+		QPoint position = player;
+		stepPlayer(maze, generator.corridors(), run, player, direction, first_step);
+		first_step = false;
+		if (position != player) {
+			result.steps++;
+			if (maze->cell(position.x(), position.y()).pathMarker() == 0) {
+				int col_delta = player.x() - position.x();
+				int row_delta = player.y() - position.y();
+				maze->cellMutable(position.x(), position.y()).setPathMarker(col_delta ? 180 - (col_delta * 90) : 360 - ((row_delta + 1) * 90));
+			}
+		}
+		targets.removeAll(player);
+	}
+
+	result.targets = targets.size();
+	result.player = player;
+	result.valid = (next == m_events.size()) && (m_steps == -1 || m_steps == result.steps);
+	delete maze;
+	return result;
+}
+
+// ============================================================================
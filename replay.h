@@ -0,0 +1,94 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <QPoint>
+#include <QVector>
+class QString;
+
+// Inputs of a game, kept so that the game can be played back exactly
+class Replay
+{
+public:
+	enum EventType {
+		DirectionKey,
+		FlagKey,
+		OtherKey,
+		VoiceCommand
+	};
+
+	// Input made after the player was moved a number of times
+	struct Event
+	{
+		int moves;
+		int msecs;
+		int type;
+		int value;
+	};
+
+	// Outcome of playing back without showing the game
+	struct Result
+	{
+		int moves;
+		int steps;
+		int targets;
+		QPoint player;
+		bool valid;
+	};
+
+	Replay();
+
+	unsigned int seed() const
+		{ return m_seed; }
+	int algorithm() const
+		{ return m_algorithm; }
+	int columns() const
+		{ return m_columns; }
+	int rows() const
+		{ return m_rows; }
+	int targets() const
+		{ return m_targets; }
+	const QVector<Event>& events() const
+		{ return m_events; }
+	int steps() const
+		{ return m_steps; }
+	int msecs() const
+		{ return m_msecs; }
+
+	void start(unsigned int seed, int algorithm, int columns, int rows, int targets);
+	void record(int moves, int msecs, EventType type, int value);
+	void finish(int steps, int msecs);
+	bool load(const QString& filename);
+	bool save(const QString& filename) const;
+	Result play() const;
+
+private:
+	unsigned int m_seed;
+	int m_algorithm;
+	int m_columns;
+	int m_rows;
+	int m_targets;
+	QVector<Event> m_events;
+	int m_steps;
+	int m_msecs;
+};
+
+#endif // REPLAY_H
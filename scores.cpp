@@ -44,26 +44,57 @@
 namespace {
 // ============================================================================
 
+// Square boards keep the key they had before mazes could be oblong
+QString sizeKey(int columns, int rows)
+{
+	return (columns == rows) ? QString::number(columns) : QString("%1x%2").arg(columns).arg(rows);
+}
+
+// ============================================================================
+
+bool readSizeKey(const QString& key, int& columns, int& rows)
+{
+	QStringList dimensions = key.split('x');
+	if (dimensions.size() > 2) {
+		return false;
+	}
+	columns = dimensions.first().toInt();
+	rows = dimensions.last().toInt();
+	return (columns > 0) && (rows > 0);
+}
+
+// ============================================================================
+
+QString sizeText(int columns, int rows)
+{
+	return QString("%1x%2").arg(columns).arg(rows);
+}
+
+// ============================================================================
+
 class Score : public QTreeWidgetItem
 {
 public:
-	Score(int seconds, int steps, int algorithm);
+	Score(int seconds, int steps, int algorithm, int optimal);
 
 	virtual bool operator<(const QTreeWidgetItem& other) const;
 };
 
 // ============================================================================
 
-Score::Score(int seconds, int steps, int algorithm)
+Score::Score(int seconds, int steps, int algorithm, int optimal)
 :	QTreeWidgetItem(1001)
 {
 	setData(1, Qt::UserRole, QString::number(seconds));
 	setText(2, QString::number(steps));
-	setData(3, Qt::UserRole, QString::number(algorithm));
+	setData(3, Qt::UserRole, QString::number(optimal));
+	setText(3, (optimal != -1) ? QString::number(optimal) : QString("-"));
+	setData(4, Qt::UserRole, QString::number(algorithm));
 
 	setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
 	setTextAlignment(2, Qt::AlignRight | Qt::AlignVCenter);
-	setTextAlignment(3, Qt::AlignCenter | Qt::AlignVCenter);
+	setTextAlignment(3, Qt::AlignRight | Qt::AlignVCenter);
+	setTextAlignment(4, Qt::AlignCenter | Qt::AlignVCenter);
 
 	int minutes = seconds / 60;
 	seconds -= (minutes * 60);
@@ -80,10 +111,13 @@ Score::Score(int seconds, int steps, int algorithm)
 		<< QLabel::tr("Stack 2")
 		<< QLabel::tr("Stack 3")
 		<< QLabel::tr("Stack 4")
-		<< QLabel::tr("Stack 5");
+		<< QLabel::tr("Stack 5")
+		<< QLabel::tr("Fast Kruskal")
+		<< QLabel::tr("Fast Prim")
+		<< QLabel::tr("Fast Hunt and Kill");
 	Q_ASSERT(algorithm > -1);
 	Q_ASSERT(algorithm < algorithms.size());
-	setText(3, algorithms.at(algorithm));
+	setText(4, algorithms.at(algorithm));
 }
 
 // ============================================================================
@@ -119,8 +153,8 @@ ScoreBoard::ScoreBoard(QWidget* parent)
 :	QTreeWidget(parent)
 {
 	setRootIsDecorated(false);
-	setColumnCount(4);
-	setHeaderLabels(QStringList() << tr("Name") << tr("Time") << tr("Steps") << tr("Algorithm"));
+	setColumnCount(5);
+	setHeaderLabels(QStringList() << tr("Name") << tr("Time") << tr("Steps") << tr("Optimal") << tr("Algorithm"));
 	header()->setStretchLastSection(false);
 	header()->setResizeMode(QHeaderView::ResizeToContents);
 }
@@ -137,7 +171,7 @@ void ScoreBoard::updateItems()
 
 	// Update minimum width
 	int w = (frameWidth() * 2) + verticalScrollBar()->sizeHint().width();
-	for (int i = 0; i < 4; ++i) {
+	for (int i = 0; i < 5; ++i) {
 		w += columnWidth(i);
 	}
 	setMinimumSize(w, header()->height() + sizeHintForRow(0) * 10 + frameWidth() * 2);
@@ -176,11 +210,12 @@ Scores::Scores(QWidget* parent)
 
 // ============================================================================
 
-void Scores::addScore(int steps, int seconds, int algorithm, int size)
+void Scores::addScore(int steps, int seconds, int algorithm, int columns, int rows, int optimal)
 {
 	// Find high score board
 	ScoreBoard* board;
-	int pos = m_sizes->findText(QString::number(size));
+	QString key = sizeKey(columns, rows);
+	int pos = m_sizes->findData(key);
 	if (pos != -1) {
 		// Access already loaded one
 		board = dynamic_cast<ScoreBoard*>(m_lists->widget(pos));
@@ -191,12 +226,15 @@ void Scores::addScore(int steps, int seconds, int algorithm, int size)
 		// Create new one
 		board = new ScoreBoard(this);
 		int count = m_sizes->count();
+		int item_columns, item_rows;
 		for (pos = 0; pos < count; ++pos) {
-			if (size < m_sizes->itemText(pos).toInt()) {
+			readSizeKey(m_sizes->itemData(pos).toString(), item_columns, item_rows);
+			if (columns * rows < item_columns * item_rows ||
+				(columns * rows == item_columns * item_rows && columns < item_columns)) {
 				break;
 			}
 		}
-		m_sizes->insertItem(pos, QString::number(size));
+		m_sizes->insertItem(pos, sizeText(columns, rows), key);
 		m_lists->insertWidget(pos, board);
 	}
 
@@ -253,7 +291,7 @@ void Scores::addScore(int steps, int seconds, int algorithm, int size)
 	}
 
 	// Create score
-	QTreeWidgetItem* score = new Score(seconds, steps, algorithm);
+	QTreeWidgetItem* score = new Score(seconds, steps, algorithm, optimal);
 	score->setText(0, name);
 	board->addTopLevelItem(score);
 	board->clearSelection();
@@ -266,9 +304,9 @@ void Scores::addScore(int steps, int seconds, int algorithm, int size)
 	count = board->topLevelItemCount();
 	for (int i = 0; i < count; ++i) {
 		item = board->topLevelItem(i);
-		values += QString("%1:%2:%3:%4") .arg(item->text(0)) .arg(item->data(1, Qt::UserRole).toInt()) .arg(item->text(2)) .arg(item->data(3, Qt::UserRole).toInt());
+		values += QString("%1:%2:%3:%4:%5") .arg(item->text(0)) .arg(item->data(1, Qt::UserRole).toInt()) .arg(item->text(2)) .arg(item->data(4, Qt::UserRole).toInt()) .arg(item->data(3, Qt::UserRole).toInt());
 	}
-	QSettings().setValue("Scores/" + QString::number(size), values);
+	QSettings().setValue("Scores/" + key, values);
 
 	show();
 }
@@ -283,11 +321,12 @@ void Scores::read()
 
 	QSettings settings;
 	settings.beginGroup("Scores");
+	int columns, rows;
 	foreach (QString key, settings.childKeys()) {
-		if (key.toInt() == 0) {
+		if (!readSizeKey(key, columns, rows)) {
 			continue;
 		}
-		m_sizes->addItem(key);
+		m_sizes->addItem(sizeText(columns, rows), key);
 
 		board = new ScoreBoard(this);
 		m_lists->addWidget(board);
@@ -295,10 +334,13 @@ void Scores::read()
 		QStringList data = settings.value(key).toStringList();
 		foreach (QString s, data) {
 			values = s.split(':');
-			if (values.size() != 4) {
+			// Scores saved before the optimal step count was kept have four values
+			if (values.size() == 4) {
+				values += "-1";
+			} else if (values.size() != 5) {
 				continue;
 			}
-			score = new Score(values[1].toInt(), values[2].toInt(), values[3].toInt());
+			score = new Score(values[1].toInt(), values[2].toInt(), values[3].toInt(), values[4].toInt());
 			score->setText(0, values[0]);
 			board->addTopLevelItem(score);
 		}
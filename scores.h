@@ -31,7 +31,7 @@ public:
 	Scores(QWidget* parent = 0);
 
 public slots:
-	void addScore(int steps, int seconds, int algorithm, int size);
+	void addScore(int steps, int seconds, int algorithm, int columns, int rows, int optimal);
 
 private:
 	void read();
@@ -19,6 +19,8 @@
 
 #include "settings.h"
 
+#include "generator.h"
+#include "maze.h"
 #include "theme.h"
 
 #include <QCheckBox>
@@ -37,6 +39,7 @@
 #include <QPushButton>
 #include <QSettings>
 #include <QSpinBox>
+#include <QStandardItemModel>
 #include <QTabWidget>
 #include <QVBoxLayout>
 
@@ -125,6 +128,23 @@ QString supportedArchiveFormats()
 
 // ============================================================================
 
+// Faster engines share the preview of the algorithm they reimplement
+int previewForAlgorithm(int algorithm)
+{
+	switch (algorithm) {
+	case 9:
+		return 1;
+	case 10:
+		return 2;
+	case 11:
+		return 0;
+	default:
+		return algorithm;
+	}
+}
+
+// ============================================================================
+
 // ControlButton class
 // ============================================================================
 
@@ -308,6 +328,9 @@ Settings::Settings(QWidget* parent)
 	m_mazes_algorithm->addItem(tr("Stack 3"), 6);
 	m_mazes_algorithm->addItem(tr("Stack 4"), 7);
 	m_mazes_algorithm->addItem(tr("Stack 5"), 8);
+	m_mazes_algorithm->addItem(tr("Fast Kruskal"), 9);
+	m_mazes_algorithm->addItem(tr("Fast Prim"), 10);
+	m_mazes_algorithm->addItem(tr("Fast Hunt and Kill"), 11);
 	connect(m_mazes_algorithm, SIGNAL(currentIndexChanged(int)), this, SLOT(algorithmSelected(int)));
 
 	m_mazes_preview = new QLabel(mazes_tab);
@@ -318,10 +341,19 @@ Settings::Settings(QWidget* parent)
 	m_mazes_size = new QSpinBox(mazes_tab);
 	m_mazes_size->setRange(10, 99);
 
+	m_mazes_large = new QCheckBox(tr("Large maze"), mazes_tab);
+	connect(m_mazes_large, SIGNAL(toggled(bool)), this, SLOT(largeToggled(bool)));
+
+	m_mazes_columns = new QSpinBox(mazes_tab);
+	m_mazes_columns->setRange(10, Maze::MaximumSize);
+
+	m_mazes_rows = new QSpinBox(mazes_tab);
+	m_mazes_rows->setRange(10, Maze::MaximumSize);
+
 	QGridLayout* mazes_layout = new QGridLayout(mazes_tab);
 	mazes_layout->setSpacing(6);
 	mazes_layout->setRowStretch(0, 1);
-	mazes_layout->setRowStretch(5, 1);
+	mazes_layout->setRowStretch(8, 1);
 	mazes_layout->setColumnStretch(0, 1);
 	mazes_layout->setColumnStretch(3, 1);
 	mazes_layout->addWidget(m_mazes_preview, 1, 2);
@@ -331,6 +363,11 @@ Settings::Settings(QWidget* parent)
 	mazes_layout->addWidget(m_mazes_targets, 3, 2);
 	mazes_layout->addWidget(new QLabel(tr("Size"), mazes_tab), 4, 1, Qt::AlignRight | Qt::AlignVCenter);
 	mazes_layout->addWidget(m_mazes_size, 4, 2);
+	mazes_layout->addWidget(m_mazes_large, 5, 2);
+	mazes_layout->addWidget(new QLabel(tr("Columns"), mazes_tab), 6, 1, Qt::AlignRight | Qt::AlignVCenter);
+	mazes_layout->addWidget(m_mazes_columns, 6, 2);
+	mazes_layout->addWidget(new QLabel(tr("Rows"), mazes_tab), 7, 1, Qt::AlignRight | Qt::AlignVCenter);
+	mazes_layout->addWidget(m_mazes_rows, 7, 2);
 
 
 	// Create Controls tab
@@ -422,6 +459,9 @@ void Settings::accept()
 	settings.setValue("New/Algorithm", m_mazes_algorithm->itemData(m_mazes_algorithm->currentIndex()));
 	settings.setValue("New/Targets", m_mazes_targets->value());
 	settings.setValue("New/Size", m_mazes_size->value());
+	settings.setValue("New/Large", m_mazes_large->isChecked());
+	settings.setValue("New/Columns", m_mazes_columns->value());
+	settings.setValue("New/Rows", m_mazes_rows->value());
 
 	// Write control button settings to disk
 	foreach (ControlButton* button, controls) {
@@ -449,7 +489,29 @@ void Settings::reject()
 void Settings::algorithmSelected(int index)
 {
 	if (index != -1) {
-		m_mazes_preview->setPixmap( QString(":/preview%1.png").arg( m_mazes_algorithm->itemData(index).toInt()) );
+		m_mazes_preview->setPixmap( QString(":/preview%1.png").arg( previewForAlgorithm(m_mazes_algorithm->itemData(index).toInt()) ) );
+	}
+}
+
+// ============================================================================
+
+void Settings::largeToggled(bool checked)
+{
+	// Allow many targets in large mazes
+	m_mazes_targets->setRange(1, checked ? Generator::MaximumTargets : 99);
+	m_mazes_size->setEnabled(!checked);
+	m_mazes_columns->setEnabled(checked);
+	m_mazes_rows->setEnabled(checked);
+
+	// Large mazes only use the faster engines
+	if (checked) {
+		int algorithm = m_mazes_algorithm->itemData(m_mazes_algorithm->currentIndex()).toInt();
+		m_mazes_algorithm->setCurrentIndex(m_mazes_algorithm->findData(Maze::largeAlgorithm(algorithm)));
+	}
+	QStandardItemModel* model = qobject_cast<QStandardItemModel*>(m_mazes_algorithm->model());
+	for (int i = 0; i < m_mazes_algorithm->count(); ++i) {
+		int algorithm = m_mazes_algorithm->itemData(i).toInt();
+		model->item(i)->setEnabled(!checked || Maze::largeAlgorithm(algorithm) == algorithm);
 	}
 }
 
@@ -571,8 +633,12 @@ void Settings::loadSettings()
 	// Read new maze settings from disk
 	int algorithm = settings.value("New/Algorithm", 4).toInt();
 	m_mazes_algorithm->setCurrentIndex(m_mazes_algorithm->findData(algorithm));
-	m_mazes_targets->setValue(settings.value("New/Targets", 3).toInt());
 	m_mazes_size->setValue(settings.value("New/Size", 50).toInt());
+	m_mazes_columns->setValue(settings.value("New/Columns", 512).toInt());
+	m_mazes_rows->setValue(settings.value("New/Rows", 512).toInt());
+	m_mazes_large->setChecked(settings.value("New/Large", false).toBool());
+	largeToggled(m_mazes_large->isChecked());
+	m_mazes_targets->setValue(settings.value("New/Targets", 3).toInt());
 
 	// Read control button settings from disk
 	foreach (ControlButton* button, controls) {
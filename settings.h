@@ -44,6 +44,7 @@ public slots:
 	virtual void accept();
 	virtual void reject();
 	void algorithmSelected(int index);
+	void largeToggled(bool checked);
 	void themeSelected(const QString& theme);
 	void addTheme();
 	void removeTheme();
@@ -61,6 +62,9 @@ private:
 	QComboBox* m_mazes_algorithm;
 	QSpinBox* m_mazes_targets;
 	QSpinBox* m_mazes_size;
+	QCheckBox* m_mazes_large;
+	QSpinBox* m_mazes_columns;
+	QSpinBox* m_mazes_rows;
 
 	QListWidget* m_themes_selector;
 	QLabel* m_themes_preview;
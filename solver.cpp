@@ -0,0 +1,353 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+
+#include "solver.h"
+
+#include "maze.h"
+
+namespace {
+// ============================================================================
+
+// Flags kept per cell while finding a route
+enum RouteFlag {
+	Marked = 0x01, // on the way from the start or a target to the root
+	Above = 0x02, // on the way from the start to the root
+	Wanted = 0x04,
+	Needed = 0x08, // leads to a target
+	Last = 0x10 // leads to the farthest target
+};
+
+// ============================================================================
+
+bool isOpen(const Cell& cell, int direction)
+{
+	switch (direction) {
+	case 1:
+		return !cell.rightWall();
+	case 2:
+		return !cell.topWall();
+	case 3:
+		return !cell.leftWall();
+	default:
+		return !cell.bottomWall();
+	}
+}
+
+// ============================================================================
+
+int opposite(int direction)
+{
+	return ((direction + 1) % 4) + 1;
+}
+
+// ============================================================================
+}
+
+// ============================================================================
+
+Solver::Solver()
+:	m_columns(0),
+	m_rows(0),
+	m_root(-1)
+{
+}
+
+// ============================================================================
+
+void Solver::build(const Maze* maze, const QPoint& root)
+{
+	m_columns = maze->columns();
+	m_rows = maze->rows();
+	m_root = index(root);
+	m_parents = QByteArray((m_columns * m_rows + 3) / 4, 0);
+	uchar* parents = reinterpret_cast<uchar*>(m_parents.data());
+
+	// Walk the tree depth first without a stack; a finished cell goes back to
+	// its parent, which carries on with the directions after that cell
+	int cell = m_root;
+	int up = -1;
+	int direction = 1;
+	for (;;) {
+		const Cell& walls = maze->cell(cell % m_columns, cell / m_columns);
+		int next = -1;
+		for (; direction < 5; ++direction) {
+			if (isOpen(walls, direction)) {
+				next = neighbor(cell, direction);
+				if (next != -1 && next != up) {
+					break;
+				}
+				next = -1;
+			}
+		}
+
+		if (next != -1) {
+			parents[next >> 2] |= (opposite(direction) - 1) << ((next & 3) * 2);
+			up = cell;
+			cell = next;
+			direction = 1;
+		} else if (cell == m_root) {
+			break;
+		} else {
+			direction = directionTo(up, cell) + 1;
+			cell = up;
+			up = parent(cell);
+		}
+	}
+}
+
+// ============================================================================
+
+void Solver::clear()
+{
+	m_columns = 0;
+	m_rows = 0;
+	m_root = -1;
+	m_parents.clear();
+}
+
+// ============================================================================
+
+int Solver::depth(const QPoint& cell) const
+{
+	int depth = 0;
+	for (int i = parent(index(cell)); i != -1; i = parent(i)) {
+		depth++;
+	}
+	return depth;
+}
+
+// ============================================================================
+
+QList<QPoint> Solver::path(const QPoint& from, const QPoint& to) const
+{
+	// Climb from both cells to where their ways to the root meet
+	int start = index(from);
+	int goal = index(to);
+	int start_depth = depth(from);
+	int goal_depth = depth(to);
+	QList<QPoint> head;
+	QList<QPoint> tail;
+	for (; start_depth > goal_depth; --start_depth) {
+		head.append(point(start));
+		start = parent(start);
+	}
+	for (; goal_depth > start_depth; --goal_depth) {
+		tail.prepend(point(goal));
+		goal = parent(goal);
+	}
+	while (start != goal) {
+		head.append(point(start));
+		start = parent(start);
+		tail.prepend(point(goal));
+		goal = parent(goal);
+	}
+	head.append(point(start));
+	return head + tail;
+}
+
+// ============================================================================
+
+QList<QPoint> Solver::route(const QPoint& from, const QList<QPoint>& targets, int* steps) const
+{
+	int start = index(from);
+	QByteArray data(m_columns * m_rows, 0);
+	uchar* flags = reinterpret_cast<uchar*>(data.data());
+
+	// The tree joining the start and the targets lies within their ways to
+	// the root; the cells above the start are walked turned around
+	for (int cell = start; cell != -1; cell = parent(cell)) {
+		flags[cell] |= (cell == start) ? Marked : (Marked | Above);
+	}
+	foreach (const QPoint& target, targets) {
+		int cell = index(target);
+		if (cell != start) {
+			flags[cell] |= Wanted;
+		}
+		for (; !(flags[cell] & Marked); cell = parent(cell)) {
+			flags[cell] |= Marked;
+		}
+	}
+
+	// Find the cells leading to targets, and the farthest target
+	int edges = 0;
+	int farthest = start;
+	int farthest_depth = 0;
+	int depth = 0;
+	int cell = start;
+	int up = -1;
+	int direction = 1;
+	for (;;) {
+		int child = nextChild(flags, cell, up, direction, 0, 0);
+		if (child != -1) {
+			up = cell;
+			cell = child;
+			direction = 1;
+			depth++;
+			if ((flags[cell] & Wanted) && depth > farthest_depth) {
+				farthest = cell;
+				farthest_depth = depth;
+			}
+			continue;
+		}
+
+		if (flags[cell] & Wanted) {
+			flags[cell] |= Needed;
+		}
+		if (cell == start) {
+			break;
+		}
+		if (flags[cell] & Needed) {
+			flags[up] |= Needed;
+			edges++;
+		}
+		direction = directionTo(up, cell) + 1;
+		cell = up;
+		up = parentFrom(flags, cell, start);
+		depth--;
+	}
+
+	// Walking the tree of needed cells takes every corridor twice, except for
+	// the ones towards the farthest target, which is left for last
+	if (steps) {
+		*steps = edges * 2 - farthest_depth;
+	}
+	for (cell = farthest; cell != start; cell = parentFrom(flags, cell, start)) {
+		flags[cell] |= Last;
+	}
+
+	// Visit targets depth first, finishing each branch before the next one;
+	// directions past 4 mean that only the last branch is left, or none
+	QList<QPoint> route;
+	cell = start;
+	up = -1;
+	direction = 1;
+	for (;;) {
+		int child = nextChild(flags, cell, up, direction, Needed | Last, Needed);
+		if (child == -1 && direction == 5) {
+			direction = 1;
+			child = nextChild(flags, cell, up, direction, Needed | Last, Needed | Last);
+		}
+		if (child != -1) {
+			up = cell;
+			cell = child;
+			direction = 1;
+			if (flags[cell] & Wanted) {
+				route.append(point(cell));
+			}
+			continue;
+		}
+
+		if (cell == start) {
+			break;
+		}
+		direction = (flags[cell] & Last) ? 6 : directionTo(up, cell) + 1;
+		cell = up;
+		up = parentFrom(flags, cell, start);
+	}
+	return route;
+}
+
+// ============================================================================
+
+int Solver::neighbor(int cell, int direction) const
+{
+	switch (direction) {
+	case 1:
+		return (cell % m_columns + 1 < m_columns) ? cell + 1 : -1;
+	case 2:
+		return (cell >= m_columns) ? cell - m_columns : -1;
+	case 3:
+		return (cell % m_columns > 0) ? cell - 1 : -1;
+	default:
+		return (cell + m_columns < m_columns * m_rows) ? cell + m_columns : -1;
+	}
+}
+
+// ============================================================================
+
+int Solver::parent(int cell) const
+{
+	if (cell == m_root) {
+		return -1;
+	}
+	switch ((uchar(m_parents.at(cell >> 2)) >> ((cell & 3) * 2)) & 3) {
+	case 0:
+		return cell + 1;
+	case 1:
+		return cell - m_columns;
+	case 2:
+		return cell - 1;
+	default:
+		return cell + m_columns;
+	}
+}
+
+// ============================================================================
+
+int Solver::parentFrom(const uchar* flags, int cell, int from) const
+{
+	// Returns the parent of a cell in the tree turned to have its root at from
+	if (cell == from) {
+		return -1;
+	} else if (!(flags[cell] & Above)) {
+		return parent(cell);
+	}
+	for (int direction = 1; direction < 5; ++direction) {
+		int other = neighbor(cell, direction);
+		if (other != -1 && (other == from || (flags[other] & Above)) && parent(other) == cell) {
+			return other;
+		}
+	}
+	return -1;
+}
+
+// ============================================================================
+
+int Solver::nextChild(const uchar* flags, int cell, int up, int& direction, int mask, int value) const
+{
+	// Returns the next marked cell joined to this one, leaving direction at it;
+	// only the start and the cells above it have their parent as a child
+	int turned = (up == -1 || (flags[cell] & Above)) ? parent(cell) : -1;
+	for (; direction < 5; ++direction) {
+		int other = neighbor(cell, direction);
+		if (other != -1 && other != up && (flags[other] & (Marked | mask)) == (Marked | value)
+				&& (other == turned || parent(other) == cell)) {
+			return other;
+		}
+	}
+	return -1;
+}
+
+// ============================================================================
+
+int Solver::directionTo(int cell, int other) const
+{
+	if (other == cell + 1) {
+		return 1;
+	} else if (other == cell - m_columns) {
+		return 2;
+	} else if (other == cell - 1) {
+		return 3;
+	} else {
+		return 4;
+	}
+}
+
+// ============================================================================
@@ -0,0 +1,62 @@
+/***********************************************************************
+ *
+ * Copyright (C) 2007-2008 Graeme Gott <graeme@gottcode.org>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ ***********************************************************************/
+
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPoint>
+class Maze;
+
+// Finds shortest paths through a maze; every algorithm builds a spanning tree
+// of the cells, so the shortest path between two cells is also the only one.
+// The tree is kept as the direction from each cell towards a root, two bits
+// per cell (directions are 1 right, 2 up, 3 left, 4 down)
+class Solver
+{
+public:
+	Solver();
+
+	void build(const Maze* maze, const QPoint& root);
+	void clear();
+
+	int depth(const QPoint& cell) const;
+	QList<QPoint> path(const QPoint& from, const QPoint& to) const;
+	QList<QPoint> route(const QPoint& from, const QList<QPoint>& targets, int* steps = 0) const;
+
+private:
+	int index(const QPoint& cell) const
+		{ return cell.y() * m_columns + cell.x(); }
+	QPoint point(int cell) const
+		{ return QPoint(cell % m_columns, cell / m_columns); }
+	int neighbor(int cell, int direction) const;
+	int parent(int cell) const;
+	int parentFrom(const uchar* flags, int cell, int from) const;
+	int nextChild(const uchar* flags, int cell, int up, int& direction, int mask, int value) const;
+	int directionTo(int cell, int other) const;
+
+	int m_columns;
+	int m_rows;
+	int m_root;
+	QByteArray m_parents; // four cells per byte
+};
+
+#endif // SOLVER_H
@@ -20,13 +20,19 @@
 #include "theme.h"
 
 #include <QApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QIcon>
+#include <QImage>
 #include <QMainWindow>
 #include <QPainter>
 #include <QSet>
 #include <QSvgRenderer>
+#include <QTime>
+#include <QtConcurrentMap>
 
 namespace {
 // ============================================================================
@@ -54,13 +60,111 @@ CornerType corners[15] = {
 	{0, 0}
 };
 
+// ============================================================================
+
+// Moves a written cache file over the previous one; if this fails there is
+// no cache, and the theme is only rendered again
+bool replaceCacheFile(const QString& path)
+{
+	QFile::remove(path);
+	return QFile::rename(path + ".new", path);
+}
+
+// ============================================================================
+
+QString cachePath()
+{
+#if defined(Q_OS_MAC)
+	QString path = QDir::homePath() + "/Library/Caches/GottCode/CuteMaze";
+#elif defined(Q_OS_UNIX)
+	QString path = getenv("XDG_CACHE_HOME");
+	if (path.isEmpty()) {
+		path = QDir::homePath() + "/.cache";
+	}
+	path += "/cutemaze";
+#elif defined(Q_OS_WIN32)
+	QString path = QDir::homePath() + "/Application Data/GottCode/CuteMaze/Cache";
+#endif
+	return path;
+}
+
+// Files that make up a theme
+const char* const theme_files[] = {
+	"background.svg",
+	"flag.svg",
+	"start.svg",
+	"target.svg",
+	"marker.svg",
+	"player.svg",
+	"corner0.svg",
+	"corner1.svg",
+	"corner2.svg",
+	"corner3.svg",
+	"corner4.svg",
+	"wall.svg"
+};
+const int theme_file_count = sizeof(theme_files) / sizeof(theme_files[0]);
+
+// ============================================================================
+
+// Renders an SVG into an image for each rotation of it that is needed
+struct RenderJob
+{
+	RenderJob(QSvgRenderer* svg_, const QSize& size_, const char* name_)
+	:	svg(svg_),
+		size(size_),
+		name(name_),
+		msecs(0)
+	{
+	}
+
+	void add(QPixmap* pixmap, int angle = 0)
+	{
+		Q_ASSERT(angle == 0 || angle == 90 || angle == 180 || angle == 270);
+		pixmaps.append(pixmap);
+		angles.append(angle);
+	}
+
+	QSvgRenderer* svg;
+	QSize size;
+	const char* name;
+	QList<QPixmap*> pixmaps;
+	QList<int> angles;
+	QList<QImage> images;
+	int msecs;
+};
+
+void renderJob(RenderJob& job)
+{
+	QTime time;
+	time.start();
+
+	QImage image(job.size, QImage::Format_ARGB32_Premultiplied);
+	image.fill(0);
+	QPainter painter(&image);
+	job.svg->render(&painter, QRect(QPoint(0, 0), job.size));
+	painter.end();
+
+	// Handle rotated images
+	foreach (int angle, job.angles) {
+		if (angle) {
+			job.images.append(image.transformed(QTransform().rotate(angle), Qt::SmoothTransformation));
+		} else {
+			job.images.append(image);
+		}
+	}
+
+	job.msecs = time.elapsed();
+}
+
 // ============================================================================
 }
 
 // ============================================================================
 
 Theme::Theme()
-:	m_unit(32)
+:	m_renderers_loaded(false),
+	m_unit(32)
 {
 	for (int i = 0; i < TotalElements; ++i) {
 		m_svg[i] = new QSvgRenderer;
@@ -149,16 +253,19 @@ void Theme::load(const QString& name)
 		}
 	}
 
-	m_svg[Background]->load(findFile(name, "background.svg"));
-	m_svg[Flag]->load(findFile(name, "flag.svg"));
-	m_svg[Start]->load(findFile(name, "start.svg"));
-	m_svg[Target]->load(findFile(name, "target.svg"));
-	m_svg_rotated[Marker]->load(findFile(name, "marker.svg"));
-	m_svg_rotated[Player]->load(findFile(name, "player.svg"));
-	for (int i = 0; i < 5; ++i) {
-		m_svg_corner[i]->load(findFile(name, QString("corner%1.svg").arg(i)));
+	// Identify rendered images by the contents of the theme files, since
+	// files built into the program have no modification time
+	m_name = name;
+	QCryptographicHash hash(QCryptographicHash::Md5);
+	for (int i = 0; i < theme_file_count; ++i) {
+		QFile file(findFile(name, theme_files[i]));
+		if (file.open(QIODevice::ReadOnly)) {
+			hash.addData(file.readAll());
+		}
+		hash.addData(theme_files[i]);
 	}
-	m_svg_wall->load(findFile(name, "wall.svg"));
+	m_cache_key = name + "|" + hash.result().toHex();
+	m_renderers_loaded = false;
 
 	scale(m_unit);
 }
@@ -169,28 +276,64 @@ void Theme::scale(int unit)
 {
 	Q_ASSERT(unit > 31);
 	m_unit = unit;
+	m_render_times.clear();
 
-	QRect bounds(0, 0, unit * 2, unit * 2);
-	cache(m_svg[Flag], m_pixmap[Flag], bounds);
-	cache(m_svg[Start], m_pixmap[Start], bounds);
-	cache(m_svg[Target], m_pixmap[Target], bounds);
+	// Use images rendered by a previous run if the theme is unchanged
+	if (loadCache()) {
+		return;
+	}
+	loadRenderers();
+
+	// Render each SVG once, and rotate it for every pixmap that uses it
+	QList<RenderJob> jobs;
+	QSize size(unit * 2, unit * 2);
+	jobs.append(RenderJob(m_svg[Flag], size, "flag"));
+	jobs.last().add(&m_pixmap[Flag]);
+	jobs.append(RenderJob(m_svg[Start], size, "start"));
+	jobs.last().add(&m_pixmap[Start]);
+	jobs.append(RenderJob(m_svg[Target], size, "target"));
+	jobs.last().add(&m_pixmap[Target]);
+	jobs.append(RenderJob(m_svg_rotated[Marker], size, "marker"));
+	jobs.append(RenderJob(m_svg_rotated[Player], size, "player"));
 	for (int i = 0; i < 4; ++i) {
-		cache(m_svg_rotated[Marker], m_pixmap_rotated[Marker][i], bounds, i * 90);
-		cache(m_svg_rotated[Player], m_pixmap_rotated[Player][i], bounds, i * 90);
+		jobs[jobs.size() - 2].add(&m_pixmap_rotated[Marker][i], i * 90);
+		jobs[jobs.size() - 1].add(&m_pixmap_rotated[Player][i], i * 90);
 	}
 
-	bounds.setSize(QSize(unit, unit));
-	for (int i = 0; i < 15; ++i) {
-		const CornerType& corner = corners[i];
-		cache(m_svg_corner[corner.renderer], m_pixmap_corner[i], bounds, corner.transform * 90);
+	size = QSize(unit, unit);
+	static const char* const corner_names[5] = { "corner0", "corner1", "corner2", "corner3", "corner4" };
+	for (int i = 0; i < 5; ++i) {
+		jobs.append(RenderJob(m_svg_corner[i], size, corner_names[i]));
+		for (int j = 0; j < 15; ++j) {
+			if (corners[j].renderer == i) {
+				jobs.last().add(&m_pixmap_corner[j], corners[j].transform * 90);
+			}
+		}
 	}
 
-	bounds.setSize(QSize(unit * 2, unit));
-	cache(m_svg_wall, m_pixmap_wall[0], bounds);
-	cache(m_svg_wall, m_pixmap_wall[1], bounds, 90);
+	size = QSize(unit * 2, unit);
+	jobs.append(RenderJob(m_svg_wall, size, "wall"));
+	jobs.last().add(&m_pixmap_wall[0]);
+	jobs.last().add(&m_pixmap_wall[1], 90);
+
+	size = QSize(unit * 3, unit * 3);
+	jobs.append(RenderJob(m_svg[Background], size, "background"));
+	jobs.last().add(&m_pixmap[Background]);
 
-	bounds.setSize(QSize(unit * 3, unit * 3));
-	cache(m_svg[Background], m_pixmap[Background], bounds);
+	// Each job has its own renderer, so they can run at the same time
+	QtConcurrent::blockingMap(jobs, renderJob);
+
+	// Pixmaps can only be created in the GUI thread
+	for (int i = 0; i < jobs.size(); ++i) {
+		const RenderJob& job = jobs.at(i);
+		for (int j = 0; j < job.pixmaps.size(); ++j) {
+			*job.pixmaps[j] = QPixmap::fromImage(job.images.at(j));
+		}
+		m_render_times.append(qMakePair(QString(job.name), job.msecs));
+	}
+
+	createAtlas();
+	saveCache();
 }
 
 // ============================================================================
@@ -235,18 +378,212 @@ void Theme::drawWall(QPainter& painter, int column, int row, bool vertical) cons
 
 // ============================================================================
 
-void Theme::cache(QSvgRenderer* svg, QPixmap& pixmap, const QRect& bounds, int angle) const
+void Theme::batch(int column, int row, enum Element element)
 {
-	pixmap = QPixmap(bounds.size());
-	pixmap.fill(QColor(255, 255, 255, 0));
-	QPainter painter(&pixmap);
-	svg->render(&painter, bounds);
+	Q_ASSERT(element != TotalElements);
+	m_batch.append(qMakePair(QPoint(column * 3 * m_unit, row * 3 * m_unit), m_atlas_rect[element]));
+}
 
-	// Handle rotated images
-	if (angle) {
-		Q_ASSERT(angle == 90 || angle == 180 || angle == 270);
-		painter.end();
-		pixmap = pixmap.transformed(QTransform().rotate(angle), Qt::SmoothTransformation);
+// ============================================================================
+
+void Theme::batch(int column, int row, enum RotatedElement element, int angle)
+{
+	Q_ASSERT(element != TotalRotatedElements);
+	Q_ASSERT(angle == 90 || angle == 180 || angle == 270 || angle == 360);
+	angle /= 90;
+	if (angle == 4)
+		angle = 0;
+	m_batch.append(qMakePair(QPoint(column * 3 * m_unit, row * 3 * m_unit), m_atlas_rect_rotated[element][angle]));
+}
+
+// ============================================================================
+
+void Theme::batchCorner(int column, int row, unsigned char walls)
+{
+	Q_ASSERT(walls > 0);
+	Q_ASSERT(walls < 16);
+	m_batch.append(qMakePair(QPoint((column * 3 * m_unit) - m_unit, (row * 3 * m_unit) - m_unit), m_atlas_rect_corner[walls - 1]));
+}
+
+// ============================================================================
+
+void Theme::batchWall(int column, int row, bool vertical)
+{
+	if (vertical) {
+		m_batch.append(qMakePair(QPoint((column * 3 * m_unit) - m_unit, row * 3 * m_unit), m_atlas_rect_wall[1]));
+	} else {
+		m_batch.append(qMakePair(QPoint(column * 3 * m_unit, (row * 3 * m_unit) - m_unit), m_atlas_rect_wall[0]));
+	}
+}
+
+// ============================================================================
+
+void Theme::drawBatch(QPainter& painter)
+{
+#if QT_VERSION >= 0x040700
+	// Fragments are positioned by their centers
+	QVector<QPainter::PixmapFragment> fragments;
+	fragments.reserve(m_batch.size());
+	for (int i = 0; i < m_batch.size(); ++i) {
+		const QRect& source = m_batch.at(i).second;
+		QPointF center = QPointF(m_batch.at(i).first) + QPointF(source.width() * 0.5, source.height() * 0.5);
+		fragments.append(QPainter::PixmapFragment::create(center, source));
+	}
+	painter.drawPixmapFragments(fragments.constData(), fragments.size(), m_atlas);
+#else
+	for (int i = 0; i < m_batch.size(); ++i) {
+		painter.drawPixmap(m_batch.at(i).first, m_atlas, m_batch.at(i).second);
+	}
+#endif
+	m_batch.clear();
+}
+
+// ============================================================================
+
+void Theme::loadRenderers()
+{
+	if (m_renderers_loaded) {
+		return;
+	}
+	m_renderers_loaded = true;
+
+	m_svg[Background]->load(findFile(m_name, "background.svg"));
+	m_svg[Flag]->load(findFile(m_name, "flag.svg"));
+	m_svg[Start]->load(findFile(m_name, "start.svg"));
+	m_svg[Target]->load(findFile(m_name, "target.svg"));
+	m_svg_rotated[Marker]->load(findFile(m_name, "marker.svg"));
+	m_svg_rotated[Player]->load(findFile(m_name, "player.svg"));
+	for (int i = 0; i < 5; ++i) {
+		m_svg_corner[i]->load(findFile(m_name, QString("corner%1.svg").arg(i)));
+	}
+	m_svg_wall->load(findFile(m_name, "wall.svg"));
+}
+
+// ============================================================================
+
+QList<QPair<QPixmap*, QRect*> > Theme::atlasEntries()
+{
+	QList<QPair<QPixmap*, QRect*> > entries;
+	for (int i = 0; i < TotalElements; ++i) {
+		entries.append(qMakePair(&m_pixmap[i], &m_atlas_rect[i]));
+	}
+	for (int i = 0; i < TotalRotatedElements; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			entries.append(qMakePair(&m_pixmap_rotated[i][j], &m_atlas_rect_rotated[i][j]));
+		}
+	}
+	for (int i = 0; i < 15; ++i) {
+		entries.append(qMakePair(&m_pixmap_corner[i], &m_atlas_rect_corner[i]));
+	}
+	for (int i = 0; i < 2; ++i) {
+		entries.append(qMakePair(&m_pixmap_wall[i], &m_atlas_rect_wall[i]));
+	}
+	return entries;
+}
+
+// ============================================================================
+
+void Theme::createAtlas()
+{
+	// Place pixmaps side by side
+	QList<QPair<QPixmap*, QRect*> > entries = atlasEntries();
+	int width = 0;
+	int height = 0;
+	for (int i = 0; i < entries.size(); ++i) {
+		const QPixmap* pixmap = entries[i].first;
+		*entries[i].second = QRect(QPoint(width, 0), pixmap->size());
+		width += pixmap->width();
+		height = qMax(height, pixmap->height());
+	}
+
+	// Copy pixmaps
+	m_atlas = QPixmap(width, height);
+	m_atlas.fill(QColor(255, 255, 255, 0));
+	QPainter painter(&m_atlas);
+	painter.setCompositionMode(QPainter::CompositionMode_Source);
+	for (int i = 0; i < entries.size(); ++i) {
+		painter.drawPixmap(entries[i].second->topLeft(), *entries[i].first);
+	}
+}
+
+// ============================================================================
+
+QString Theme::cacheFile(const QString& suffix) const
+{
+	return QString("%1/%2-%3.%4").arg(cachePath()).arg(m_name).arg(m_unit).arg(suffix);
+}
+
+// ============================================================================
+
+bool Theme::loadCache()
+{
+	// Read index
+	QFile file(cacheFile("index"));
+	if (!file.open(QIODevice::ReadOnly)) {
+		return false;
+	}
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_3);
+	QString key;
+	int unit;
+	QList<QRect> rects;
+	stream >> key >> unit >> rects;
+	QList<QPair<QPixmap*, QRect*> > entries = atlasEntries();
+	if (stream.status() != QDataStream::Ok || key != m_cache_key || unit != m_unit || rects.size() != entries.size()) {
+		return false;
+	}
+
+	// Read images, which carry the key of the index they were written with
+	QImage image;
+	if (!image.load(cacheFile("png"), "PNG") || image.text("Key") != key) {
+		return false;
+	}
+	QPixmap atlas = QPixmap::fromImage(image);
+	foreach (const QRect& rect, rects) {
+		if (!atlas.rect().contains(rect)) {
+			return false;
+		}
+	}
+	m_atlas = atlas;
+	for (int i = 0; i < entries.size(); ++i) {
+		*entries[i].second = rects[i];
+		*entries[i].first = m_atlas.copy(rects[i]);
+	}
+	return true;
+}
+
+// ============================================================================
+
+void Theme::saveCache()
+{
+	if (!QDir().mkpath(cachePath())) {
+		return;
+	}
+
+	// Write each file beside the cache and then move it into place, so that
+	// neither is ever seen half written; the key in both finds a mismatch
+	QImage image = m_atlas.toImage();
+	image.setText("Key", m_cache_key);
+	if (!image.save(cacheFile("png") + ".new", "PNG") || !replaceCacheFile(cacheFile("png"))) {
+		return;
+	}
+
+	QList<QRect> rects;
+	QList<QPair<QPixmap*, QRect*> > entries = atlasEntries();
+	for (int i = 0; i < entries.size(); ++i) {
+		rects.append(*entries[i].second);
+	}
+
+	QFile file(cacheFile("index") + ".new");
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		return;
+	}
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_3);
+	stream << m_cache_key << m_unit << rects;
+	file.close();
+	if (stream.status() != QDataStream::Ok || !replaceCacheFile(cacheFile("index"))) {
+		QFile::remove(file.fileName());
 	}
 }
 
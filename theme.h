@@ -20,8 +20,12 @@
 #ifndef THEME_H
 #define THEME_H
 
+#include <QPair>
 #include <QPixmap>
+#include <QRect>
 #include <QString>
+#include <QStringList>
+#include <QVector>
 class QPainter;
 class QSvgRenderer;
 
@@ -34,6 +38,8 @@ public:
 	QStringList available() const;
 	void load(const QString& name);
 	void scale(int unit);
+	QList<QPair<QString, int> > renderTimes() const
+		{ return m_render_times; }
 
 	enum Element {
 		Background,
@@ -52,11 +58,25 @@ public:
 	void drawCorner(QPainter& painter, int column, int row, unsigned char walls) const;
 	void drawWall(QPainter& painter, int column, int row, bool vertical = false) const;
 
+	void batch(int column, int row, enum Element element);
+	void batch(int column, int row, enum RotatedElement element, int angle);
+	void batchCorner(int column, int row, unsigned char walls);
+	void batchWall(int column, int row, bool vertical = false);
+	void drawBatch(QPainter& painter);
+
 private:
-	void cache(QSvgRenderer* svg, QPixmap& pixmap, const QRect& bounds, int angle = 0) const;
+	void loadRenderers();
+	QList<QPair<QPixmap*, QRect*> > atlasEntries();
+	void createAtlas();
+	QString cacheFile(const QString& suffix) const;
+	bool loadCache();
+	void saveCache();
 	QString findFile(const QString& theme, const QString& file) const;
 
 	QStringList m_locations;
+	QString m_name;
+	QString m_cache_key;
+	bool m_renderers_loaded;
 	QSvgRenderer* m_svg[TotalElements];
 	QSvgRenderer* m_svg_rotated[TotalRotatedElements];
 	QSvgRenderer* m_svg_corner[5];
@@ -66,6 +86,15 @@ private:
 	QPixmap m_pixmap_corner[15];
 	QPixmap m_pixmap_wall[2];
 	int m_unit;
+	QList<QPair<QString, int> > m_render_times; // msecs of each SVG last rendered
+
+	// All pixmaps in one, so that batched tiles come from a single source
+	QPixmap m_atlas;
+	QRect m_atlas_rect[TotalElements];
+	QRect m_atlas_rect_rotated[TotalRotatedElements][4];
+	QRect m_atlas_rect_corner[15];
+	QRect m_atlas_rect_wall[2];
+	QVector<QPair<QPoint, QRect> > m_batch;
 };
 
 #endif // THEME_H
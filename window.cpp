@@ -277,7 +277,7 @@ Window::Window()
 
 	// Create scores window
 	m_scores = new Scores(this);
-	connect(m_board, SIGNAL(finished(int, int, int, int)), m_scores, SLOT(addScore(int, int, int, int)));
+	connect(m_board, SIGNAL(finished(int, int, int, int, int, int)), m_scores, SLOT(addScore(int, int, int, int, int, int)));
 	m_scores->installEventFilter(this);
 
 	// Create actions
@@ -291,6 +291,15 @@ Window::Window()
 	connect(m_pause_action, SIGNAL(toggled(bool)), m_board, SLOT(pauseGame(bool)));
 	connect(m_board, SIGNAL(pauseAvailable(bool)), m_pause_action, SLOT(setEnabled(bool)));
 	connect(m_board, SIGNAL(pauseChecked(bool)), m_pause_action, SLOT(setChecked(bool)));
+	m_overview_action->setShortcut(Qt::Key_O);
+	m_overview_action->setCheckable(true);
+	connect(m_overview_action, SIGNAL(toggled(bool)), m_board, SLOT(showOverview(bool)));
+	m_route_action->setShortcut(Qt::Key_R);
+	m_route_action->setCheckable(true);
+	connect(m_route_action, SIGNAL(toggled(bool)), m_board, SLOT(showRoute(bool)));
+	m_statistics_action->setShortcut(Qt::Key_F3);
+	m_statistics_action->setCheckable(true);
+	connect(m_statistics_action, SIGNAL(toggled(bool)), m_board, SLOT(showStatistics(bool)));
 
 	// Setup window
 	setWindowTitle(tr("CuteMaze"));
@@ -355,6 +364,9 @@ void Window::initMenuBar()
 	QMenu* game_menu = menuBar()->addMenu(tr("Game"));
 	game_menu->addAction(tr("New Game"), m_board, SLOT(newGame()), tr("Ctrl+N"));
 	m_pause_action = game_menu->addAction(tr("Pause Game"));
+	m_overview_action = game_menu->addAction(tr("Show Overview"));
+	m_route_action = game_menu->addAction(tr("Show Route"));
+	m_statistics_action = game_menu->addAction(tr("Show Statistics"));
 	game_menu->addAction(tr("High Scores"), m_scores, SLOT(show()), tr("Ctrl+H"));
 	game_menu->addAction(tr("Settings"), m_settings, SLOT(show()));
 	game_menu->addAction(tr("Quit"), this, SLOT(close()), tr("Ctrl+Q"));
@@ -385,6 +397,9 @@ void Window::initToolBar()
 	action = toolbar->addAction(icons.at(0), tr("New"), m_board, SLOT(newGame()));
 	action->setShortcut(tr("Ctrl+N"));
 	m_pause_action = toolbar->addAction(icons.at(1), tr("Pause"));
+	m_overview_action = toolbar->addAction(tr("Overview"));
+	m_route_action = toolbar->addAction(tr("Route"));
+	m_statistics_action = toolbar->addAction(tr("Statistics"));
 	action = toolbar->addAction(icons.at(2), tr("Scores"), m_scores, SLOT(show()));
 	action->setShortcut(tr("Ctrl+H"));
 	action = toolbar->addAction(icons.at(3), tr("Settings"), m_settings, SLOT(show()));
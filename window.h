@@ -44,6 +44,9 @@ private:
 	Scores* m_scores;
 	Settings* m_settings;
 	QAction* m_pause_action;
+	QAction* m_overview_action;
+	QAction* m_route_action;
+	QAction* m_statistics_action;
 	int m_pause_count;
 	bool m_was_paused;
 	bool m_pause_available;